@@ -13,7 +13,13 @@
 #include <avr/io.h>
 #include <avr/common.h>
 #include <util/delay.h>
+#include <util/crc16.h>
 #include "ds18x20.h"
+
+uint8_t DS18x20_parasite = 1;
+uint8_t DS18x20_family = DS18x20_FAMILY_S20;
+uint8_t DS18x20_cvt = DS18x20_CVT_S20;
+static uint8_t config;	// 1 = DS18B20 configuration register to be written
 
 /*
  * DS18x20 init
@@ -107,29 +113,105 @@ int16_t DS18x20_startcv()
 
 	if (DS18x20_reset() == 0) {
 
-#if DS18x20_RES > 0
-		DS18x20_writebyte(DS18x20_CMD_WSCRATCHPAD);
-		DS18x20_writebyte(0);	// TH user byte 1
-		DS18x20_writebyte(0);	// TL user byte 2
-		DS18x20_writebyte(DS18x20_RES);
-		DS18x20_reset();
-#endif // DS18x20_RES
+		if (config) {	// DS18B20 not at 9 bit: write and copy to its eeprom once
+			DS18x20_writebyte(DS18x20_CMD_SKIPROM);
+			DS18x20_writebyte(DS18x20_CMD_WSCRATCHPAD);
+			DS18x20_writebyte(0);	// TH user byte 1
+			DS18x20_writebyte(0);	// TL user byte 2
+			DS18x20_writebyte(DS18x20_B20_CONFIG);
+			DS18x20_reset();
+			DS18x20_writebyte(DS18x20_CMD_SKIPROM);
+			DS18x20_writebyte(DS18x20_CMD_CPYSCRATCHPAD);
+			if (DS18x20_parasite) {
+				DS18x20_PWRON();	// strong pullup during eeprom write
+			}
+			_delay_ms(10);
+			DS18x20_PWROFF();
+			DS18x20_reset();
+			config = 0;
+		}
 
 		DS18x20_writebyte(DS18x20_CMD_SKIPROM);
 		DS18x20_writebyte(DS18x20_CMD_CONVERTTEMP);
 		temperature = DS18x20_NO_VALUE;
-		DS18x20_PWRON();
+		if (DS18x20_parasite) {
+			DS18x20_PWRON();	// strong pullup during conversion
+		}
 	}
 	return temperature;
 }
 
 /*
- * read temperature - async operation
+ * read power supply mode (sensor precharged 200[ms])
+ *
+ * returns / sets DS18x20_parasite
+ *   1 - parasite powered or no sensor reset (safe default)
+ *   0 - external supply
+ */
+uint8_t DS18x20_rdpower()
+{
+	DS18x20_PWRON();
+	_delay_ms(200);
+	DS18x20_PWROFF();
+	DS18x20_parasite = 1;
+	if (DS18x20_reset() == 0) {
+		DS18x20_writebyte(DS18x20_CMD_SKIPROM);
+		DS18x20_writebyte(DS18x20_CMD_RPWRSUPPLY);
+		DS18x20_parasite = !DS18x20_readbit();	// parasite powered sensors pull low
+	}
+	return DS18x20_parasite;
+}
+
+/*
+ * read family code (one sensor on the bus), a DS18B20 configuration
+ * register is only read, it is written by the next start of conversion if
+ * it is not at 9 bit
+ *
+ * returns / sets DS18x20_family, sets DS18x20_cvt
+ *   DS18x20_FAMILY_B20 - DS18B20 or DS1822
+ *   DS18x20_FAMILY_S20 - DS18S20, unknown family, no reset or ROM CRC error
+ */
+uint8_t DS18x20_readrom()
+{
+	uint8_t i, byte, family = 0, crc = 0;
+
+	if (DS18x20_reset() == 0) {
+		DS18x20_writebyte(DS18x20_CMD_READROM);
+		for (i = 0; i < 8; i++) {	// family code, serial number, CRC
+			byte = DS18x20_readbyte();
+			if (i == 0) {
+				family = byte;
+			}
+			crc = _crc_ibutton_update(crc, byte);
+		}
+	}
+	if (crc == 0 && (family == DS18x20_FAMILY_B20 || family == DS18x20_FAMILY_1822)) {
+		DS18x20_family = DS18x20_FAMILY_B20;
+		DS18x20_cvt = DS18x20_CVT_B20;
+		config = 1;
+		if (DS18x20_reset() == 0) {
+			DS18x20_writebyte(DS18x20_CMD_SKIPROM);
+			DS18x20_writebyte(DS18x20_CMD_RSCRATCHPAD);
+			for (i = 0; i < 5; i++) {	// temperature, TH, TL, configuration
+				byte = DS18x20_readbyte();
+			}
+			config = byte != DS18x20_B20_CONFIG;
+		}
+	} else {
+		DS18x20_family = DS18x20_FAMILY_S20;
+		DS18x20_cvt = DS18x20_CVT_S20;
+	}
+	return DS18x20_family;
+}
+
+/*
+ * read temperature - async operation, a DS18B20 configuration register
+ * not at 9 bit (sensor lost its setting) is written again by the next
+ * start of conversion
  *
  * returns
  *   DS18x20_NO_DATA - error no sensor data
- *   0x07D0...0xFC90  ~  +125[]...-55[] on 12 Bit resolution
- *   0x00AA...0xFF92  ~   +85[]...-55[] in  9 Bit resolution
+ *   0x00FA...0xFF92  ~  +125[]...-55[] in 0.5[] resolution
  */
 int16_t DS18x20_readtemp()
 {
@@ -146,6 +228,14 @@ int16_t DS18x20_readtemp()
 		//read 2 byte from scratch pad
 		temperature_l = DS18x20_readbyte();
 		temperature = (DS18x20_readbyte() << 8) + temperature_l;
+		if (DS18x20_family == DS18x20_FAMILY_B20) {
+			temperature = (int16_t)temperature >> 3;	// 1/16[] -> 0.5[]
+			DS18x20_readbyte();		// TH
+			DS18x20_readbyte();		// TL
+			config = DS18x20_readbyte() != DS18x20_B20_CONFIG;
+		}
+	} else if (DS18x20_family == DS18x20_FAMILY_B20) {
+		config = 1;		// conversion longer than 9 bit
 	}
 	return temperature;
 }
@@ -153,11 +243,10 @@ int16_t DS18x20_readtemp()
 /*
  * get temperature - sync operation
  */
-/* no sync operation
 #include <avr/interrupt.h>
 int16_t DS18x20_gettemp()
 {
-	uint8_t interrupt;
+	uint8_t interrupt, i;
 	uint16_t temperature;
 	
 	interrupt = (SREG & _BV(SREG_I));
@@ -167,7 +256,11 @@ int16_t DS18x20_gettemp()
 	if (temperature != DS18x20_NO_RESET) {
 
 		if (interrupt) sei();
-		_delay_ms(DS18x20_CVT);
+		i = DS18x20_cvt;
+		// wait conversion time, externally powered: poll conversion complete
+		while (i-- && (DS18x20_parasite || !DS18x20_readbit())) {
+			_delay_ms(10);
+		}
 		DS18x20_PWROFF();
 		if (interrupt) cli();
 		
@@ -176,5 +269,4 @@ int16_t DS18x20_gettemp()
 	if (interrupt) sei(); 
 	
 	return temperature;
-}
-*/
\ No newline at end of file
+}
\ No newline at end of file
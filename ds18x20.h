@@ -43,6 +43,17 @@
  *   section in https://datasheets.maximintegrated.com/en/ds/DS18B20.pdf)
  *   The library supports DQ and pullup control residing on the same port.
  *
+ * The sensor family is read at runtime (DS18x20_readrom(), READ ROM, only
+ * one sensor on the bus): a DS18B20 (or DS1822) is set to 9 bit resolution
+ * (written into its eeprom if not yet at 9 bit, checked with each reading),
+ * both families return binary temperatures in 0.5[] resolution and the
+ * conversion time is DS18x20_cvt. Unknown or unreadable sensors are
+ * handled as DS18S20 (longest conversion time).
+ *
+ * The power supply mode is read at runtime (DS18x20_rdpower()): an
+ * externally powered sensor needs no precharge and no strong pullup during
+ * conversion, the end of the conversion is polled (DS18x20_readbit() = 1).
+ *
  * This library support asynchronous or synchronous temperature conversion:
  *
  * - sync:  call to DS18x20_gettemp() returns after conversion finished
@@ -57,15 +68,6 @@
 
 /* ----------------- sensor definition section -----------------
  *
- * Type of sensor - set to DS18B10 or DS18S10
- */
-#define DS18x20_TYPE	DS18S10
-/*
- * Sensor resolution - set to 9, 10, 11 or 12 for DS18B20
- *                     (no effect for DS18S20)
- */
-#define DS18x20_RESOL	9
-/*
  * Operation mode - set to
  * - 0 for no parasite-powered operation
  * - 1 for parasite-power on output high
@@ -90,6 +92,13 @@
 int16_t DS18x20_gettemp();	// for sync operation
 int16_t DS18x20_startcv();	// for async operation
 int16_t DS18x20_readtemp();	// for async operation
+uint8_t DS18x20_rdpower();	// read power supply mode, sets DS18x20_parasite
+uint8_t DS18x20_readbit();	// conversion complete (externally powered only)
+uint8_t DS18x20_readrom();	// read family code, sets DS18x20_family, DS18x20_cvt
+
+extern uint8_t DS18x20_parasite;	// 1 = parasite powered (default), 0 = external supply
+extern uint8_t DS18x20_family;		// DS18x20_FAMILY_S20 or DS18x20_FAMILY_B20
+extern uint8_t DS18x20_cvt;			// conversion time [10ms]
 
 /*
  * sensor macros
@@ -110,38 +119,22 @@ int16_t DS18x20_readtemp();	// for async operation
 #  define	DS18x20_PWRINIT()	((DS18x20_DDR |= _BV(DS18x20_PWR)) && DS18x20_PWROFF())
 #endif
 
-#if DS18x20_TYPE == DS18S10
-#  define DS18x20_MAX	0x0AA	// max value on 9 Bit resolution: 85.0C
-#  define DS18x20_RES	0
-#  define DS18x20_CVT	750
-#else
-#  if DS18x20_RESOL	== 9
-#    define DS18x20_MAX	0x00FA	// max value on 9 Bit resolution: 125C
-#    define DS18x20_RES	0x1F
-#    define DS18x20_CVT	 94
-#  endif
-#  if DS18x20_RESOL	== 10
-#    define DS18x20_MAX	0x01F4	// max value on 10 Bit resolution: 125C
-#    define DS18x20_RES	0x3F
-#    define DS18x20_CVT	188
-#  endif
-#  if DS18x20_RESOL	== 11
-#    define DS18x20_MAX	0x03E8	// max value on 11 Bit resolution: 125C
-#    define DS18x20_RES	0x5F
-#    define DS18x20_CVT	375
-#  endif
-#  if DS18x20_RESOL	== 12
-#    define DS18x20_MAX	0x07D0	// max value on 12 Bit resolution: 125C
-#    define DS18x20_RES	0x6F
-#    define DS18x20_CVT	750
-#  endif
-#endif // DS18x20__TYPE == DS18S10
+/*
+ * sensor families (family code of the ROM)
+ */
+#define DS18x20_FAMILY_S20	0x10	// DS18S20: 9 bit
+#define DS18x20_FAMILY_B20	0x28	// DS18B20: 9...12 bit, set to 9 bit
+#define DS18x20_FAMILY_1822	0x22	// DS1822: as DS18B20
+
+#define DS18x20_B20_CONFIG	0x1F	// DS18B20 configuration register: 9 bit resolution
+#define DS18x20_CVT_S20		75		// conversion time [10ms]: 750[ms]
+#define DS18x20_CVT_B20		10		// conversion time [10ms]: 94[ms] @9 bit
+#define DS18x20_MAX			0x00FA	// max value on 0.5[] resolution: 125C
 
 /*
  * return values (int16_t)
  *
- * 0x07D0...0xFC90  ->  +125[]...-55[] on 12 Bit resolution
- * 0x00AA...0xFF92  ->   +85[]...-55[] on  9 Bit resolution
+ * 0x00FA...0xFF92  ->  +125[]...-55[] on 0.5[] resolution (DS18S20: +85[])
  */
 #define DS18x20_NO_VALUE	(DS18x20_MAX + 1)	// ok - no value sampled
 #define DS18x20_NO_RESET	(DS18x20_MAX + 2)	// error - no sensor reset
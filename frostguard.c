@@ -8,15 +8,100 @@
 
 // #define F_CPU 1E6	// 1,0 MHz - set in tool chain
 #include <stdint.h>
+#include <string.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/sleep.h>
+#include <avr/pgmspace.h>
+#include <avr/wdt.h>
+#include <util/delay.h>
 #include "tm1637.h"
 #include "ds18x20.h"
 #include "frostguard.h"
 #include "globals.h"
 #include "uart.h"
+#include "trace.h"
+#include "vcc.h"
 
+/**
+ * mode functions indexed by globals.mode
+ */
+typedef uint8_t (*mode_func_t)(uint8_t key);
+static const mode_func_t modes[] PROGMEM = {
+	mode_table,		// MODE_RESET
+	mode_table,		// MODE_TEMPS
+	mode_table,		// MODE_DATIME
+	mode_watch,		// MODE_WATCH
+	mode_table,		// MODE_MENU
+	mode_irrigate,	// MODE_IRRIG
+	mode_table,		// MODE_BRIGHT
+	mode_data		// MODE_DATA
+};
+
+#if CHECK_INVARIANTS
+/**
+ * invariants after mode dispatch, worst-case ISR time
+ */
+static void check_invariants(uint8_t mode)
+{
+	register uint8_t t = TCNT0;
+
+	if (IRRI_IS_ON() && globals.mode != MODE_WATCH && globals.mode != MODE_IRRIG) {
+		IRRI_OFF();
+		globals.check.violations |= INV_RELAY;
+	}
+	if (   globals.mode == MODE_WATCH
+		&& (   globals.params.temperatures.low > globals.params.temperatures.high
+			|| globals.params.brightness > MAX_BRIGHTNESS
+			|| globals.params.interval_min < 2 || globals.params.interval_min > globals.params.interval_max
+			|| globals.params.fail_policy > FAIL_STOP
+			|| globals.params.write < 0 || globals.params.write > MAX_EVENTS
+			|| globals.params.exported < 0 || globals.params.exported > globals.params.write
+			|| globals.params.head >= MAX_EVENTS)) {
+		/*
+		 * back to defaults, watch mode restarts with the repaired params
+		 */
+		globals.check.violations |= INV_PARAMS;
+		if (globals.params.temperatures.low > globals.params.temperatures.high) {
+			globals.params.temperatures.low = BINTEMP(1.0);
+			globals.params.temperatures.high = BINTEMP(3.0);
+		}
+		if (globals.params.brightness > MAX_BRIGHTNESS) {
+			globals.params.brightness = DEFAULT_BRIGHTNESS;
+		}
+		if (globals.params.interval_min < 2 || globals.params.interval_min > globals.params.interval_max) {
+			globals.params.interval_min = DEFAULT_INTERVAL_MIN;
+			globals.params.interval_max = DEFAULT_INTERVAL_MAX;
+		}
+		if (globals.params.fail_policy > FAIL_STOP) {
+			globals.params.fail_policy = DEFAULT_FAIL_POLICY;
+		}
+		if (globals.params.write < 0 || globals.params.write > MAX_EVENTS) {
+			globals.params.write = 0;
+		}
+		if (globals.params.exported < 0 || globals.params.exported > globals.params.write) {
+			globals.params.exported = globals.params.write;
+		}
+		if (globals.params.head >= MAX_EVENTS) {
+			globals.params.head = 0;
+		}
+		globals.submode = 0;
+	}
+	if (mode == MODE_DATA) {
+		return;
+	}
+	if (TIFR & _BV(OCF0A)) {	// next compare match already pending
+		globals.check.violations |= INV_OVERRUN;
+		if (globals.check.overruns < 0xFF) {
+			globals.check.overruns++;
+		}
+	} else if (t > globals.check.isr_max) {
+		globals.check.isr_max = t;
+		globals.check.isr_mode = mode;
+	}
+}
+#endif
+
 /**
  * timer interrupt service routine (100[ms])
  */
@@ -25,41 +110,57 @@ ISR(TIM0_COMPA_vect)
 	static uint8_t ticks_counter = 0;
 	static uint8_t mode_status = MDS_RUN;
 	static uint8_t key_last = KEY_NONE;
-	static uint8_t key_repeat = 0;
+	static uint8_t key_timer = 0;
+	static uint8_t key_period;
+	static uint8_t key_count;
 	register uint8_t key_scanned, key, current_mode;
 
-	/*
-	 * key scanning
-	 * - key released -> KEY_NONE
-	 * - key hit-> KEY_xxx
-	 * - key long hold -> KEY_xxx - KEY_NONE - KEY_xxx_L
+	/*
+	 * key scanning
+	 * - key released -> KEY_NONE
+	 * - key hit-> KEY_xxx
+	 * - key long hold -> KEY_xxx - KEY_NONE - KEY_xxx_L
+	 * - KEY_UP/KEY_DOWN long hold in KEY_REPEAT_MODES -> KEY_xxx - KEY_NONE
+	 *   - KEY_xxx - ... auto-repeat, accelerated up to one key per tick
 	 */
-	#define KEY_REPEAT_MAX 4
-	
 	key = KEY_NONE;
 	key_scanned = TM1637_keyscan();
 	if (key_scanned != KEY_NONE) {
 		
-		if (key_last == KEY_NONE) {
-			// key pressed & key was released
-			key = key_scanned & 0x0F;
-		} else {
-			if (key_last == key_scanned) {
-				if (key_repeat <= KEY_REPEAT_MAX) key_repeat++;
-			} else {
-				key_repeat = 0;
+		if (key_last != key_scanned) {
+			if (key_last == KEY_NONE) {
+				// key pressed & key was released
+				key = key_scanned & 0x0F;
 			}
-			if (key_repeat == KEY_REPEAT_MAX) {
+			key_timer = KEY_REPEAT_MAX;
+			key_period = KEY_REPEAT_SLOW;
+			key_count = 0;
+		} else if (key_timer > 0 && --key_timer == 0) {
+			if ((key_scanned & 0x0F) != KEY_SET && (_BV(globals.mode) & KEY_REPEAT_MODES)) {
+				key = key_scanned & 0x0F;
+				if (key_period > KEY_REPEAT_FAST && ++key_count == KEY_REPEAT_ACCEL) {
+					key_period--;
+					key_count = 0;
+				}
+				key_timer = key_period;
+			} else {
 				key = (key_scanned << 4) | (key_scanned & 0x0F);
-			} else if (key_repeat > KEY_REPEAT_MAX) {
-				key = KEY_NONE;
 			}
 		}
-	} else {
-		key_repeat = 0;
 	}
 	key_last = key_scanned;
 
+#if CHECK_INVARIANTS
+	/*
+	 * no unknown mode
+	 */
+	if (globals.mode > MODE_DATA) {
+		globals.check.violations |= INV_MODE;
+		globals.mode = MODE_WATCH;
+		globals.submode = 0;
+	}
+#endif
+
 	/*
 	 * 400[ms] blinking period and
 	 * system ticks (per 1[s]) collection
@@ -70,6 +171,10 @@ ISR(TIM0_COMPA_vect)
 	}
 	if (ticks_counter % ONE_SECOND == 0) {
 		globals.params.timestamp++;
+		if (IRRI_IS_ON()) {
+			globals.relay.on_total++;
+			globals.relay.on_night++;
+		}
 	}
 	/*
 	 * display and colon disable/enable/blink function
@@ -87,69 +192,49 @@ ISR(TIM0_COMPA_vect)
 
 	/*
 	 * mode dispatcher
+	 *
+	 * KEY_SET_L handling:
+	 * - mode WATCH -> MENU
+	 * - other -> WATCH (if not in reset)
 	 */
-	static uint8_t reset = 0;
-	/*
-	 * KEY_SET_L handling:
-	 * - mode WATCH -> MENU
-	 * - other -> WATCH (if not in reset)
-	 */
-	if (!reset && key == KEY_SET_L) {
+	if (globals.mode != MODE_RESET && key == KEY_SET_L) {
 		globals.submode = SUBMODE_EXIT;
 		key = KEY_NONE;
 	}
 
 	current_mode = globals.mode;
-	switch (globals.mode) {
-		case MODE_RESET:
-			reset = 1;
-			globals.mode = MODE_TEMPS;
-			break;
-
-		case MODE_TEMPS:
-			mode_status = mode_temperatures(key);
-			if (mode_status == MDS_DONE && reset) {
-				mode_status = MDS_RUN;
-				globals.mode = MODE_DATIME;
-				reset = 0;
-			}
-			break;
-
-		case MODE_DATIME:
-			mode_status = mode_datetime(key);
-			break;
-
-		case MODE_WATCH:
-			mode_status = mode_watch(key);
-			break;
-
-		case MODE_MENU:
-			mode_status = mode_menu(key);
-			break;
-		
-		case MODE_IRRIG:
-			mode_status = mode_irrigate(key);
-			break;
-
-		case MODE_BRIGHT:
-			mode_status = mode_brightness(key);
-			break;
-
-		case MODE_DATA:
-			mode_status = mode_data(key);
-			break;
-	}
+	mode_status = ((mode_func_t)pgm_read_ptr(&modes[current_mode]))(key);
+	TRACE_DISPATCH(key);
+	TRACE_FREEZE();
+#if CHECK_INVARIANTS
+	check_invariants(current_mode);
+#endif
 
 	if (mode_status == MDS_DONE) {
-		if (current_mode & (MODE_TEMPS | MODE_DATIME | MODE_BRIGHT)) {
-			eeprom_update_block(&globals.params, &eedata.params, sizeof(params_t));
+		if (_BV(current_mode) & (_BV(MODE_RESET) | _BV(MODE_TEMPS) | _BV(MODE_DATIME) | _BV(MODE_BRIGHT))) {
+			ee_defer(EE_PARAMS);
 		}
 		mode_status = MDS_RUN;
 	}
+	wdt_reset();
 }
 
 
 /**
+ * reset cause: the watchdog stays enabled after a watchdog reset, so it is
+ * disabled in .init3 before the C runtime initializes .data and .bss
+ */
+uint8_t mcusr_saved __attribute__((section(".noinit")));
+
+void mcusr_save(void) __attribute__((naked, used, section(".init3")));
+void mcusr_save(void)
+{
+	mcusr_saved = MCUSR;
+	MCUSR = 0;
+	wdt_disable();
+}
+
+/**
  * Initializations and go to sleep
  *
  * Timer:
@@ -164,12 +249,29 @@ ISR(TIM0_COMPA_vect)
 int main(void)
 {
 	/*
-	 * initialize globals 
-	 */
+	 * reset cause (mcusr_save()), trace of the last run
+	 */
+	globals.reset = mcusr_saved;
+	/*
+	 * initialize globals, no eeprom writes (ee_update(), ee_flush()) if the
+	 * supply voltage is below the safe state threshold already
+	 */
 	globals.mode = MODE_WATCH;
 	eeprom_read_block(&globals.params, &eedata.params, sizeof(params_t));
+	VCC_START();
+	_delay_ms(1);	// bandgap settles
+	globals.vcc = vcc_read();
+	if (globals.params.layout != PARAMS_LAYOUT) {
+		globals.params.brightness = EEUNSET;	// erased or another firmware's data
+	}
+	globals.vcc_safe = globals.vcc < (globals.params.brightness == EEUNSET ? DEFAULT_VCC_LOW : globals.params.vcc_low);
+	TRACE_INIT(globals.reset);
 	if (globals.params.brightness == EEUNSET) {
+		profile_t unset = { EEUNSET, EEUNSET };
+		uint8_t i;
+
 		globals.mode = MODE_RESET;
+		globals.params.layout = PARAMS_LAYOUT;
 		globals.params.brightness = DEFAULT_BRIGHTNESS;
 		globals.params.temperatures.low = BINTEMP(1.0);
 		globals.params.temperatures.high = BINTEMP(3.0);
@@ -177,7 +279,65 @@ int main(void)
 		globals.params.minmax.high = BINTEMP(-55.0);
 		globals.params.timestamp = DT_2021_4_5_12_0_0;
 		globals.params.write = 0;
+		globals.params.exported = 0;
+		globals.params.head = 0;
+		globals.params.lost = 0;
+		globals.params.osccal = EEUNSET;
+		globals.params.lead = DEFAULT_LEAD;
+		globals.params.interval_min = DEFAULT_INTERVAL_MIN;
+		globals.params.interval_max = DEFAULT_INTERVAL_MAX;
+		globals.params.summaries = 0;
+		globals.params.histo_base = DEFAULT_HISTO_BASE;
+		globals.params.vcc_low = DEFAULT_VCC_LOW;
+		globals.params.vcc_min = EEUNSET;
+		globals.params.fail_policy = DEFAULT_FAIL_POLICY;
+		globals.params.telemetry = 0;
+		globals.params.unit = 0;
+		globals.params.wdt_resets = 0;
+		globals.params.bor_resets = 0;
+		for (i = 0; i < PROFILE_BANDS; i++) {
+			ee_update(&unset, &eedata.profile[i], sizeof(profile_t));	// defaults by profile_load()
+		}
+#if TRACE_DEPTH > 0
+		ee_update(&unset, &eedata.trace.cause, sizeof(uint8_t));
+#endif
+		histogram_clear();
+		day_index_clear();
+		irrigation_save();	// zero accounting
+	} else {
+		uint32_t timestamp = globals.params.timestamp;
+		uint8_t i, changed = 0;
+
+		eeprom_read_block(&globals.relay, &eedata.relay, sizeof(relay_t));
+		eeprom_read_block(globals.days, eedata.days, sizeof(globals.days));
+		for (i = 0; i < DAY_INDEX; i++) {
+			if (globals.days[i].first >= globals.params.write) {	// unset or a reset between the deferred writes
+				memset(globals.days + i, 0xFF, (DAY_INDEX - i) * sizeof(daymark_t));
+				break;
+			}
+		}
+		/*
+		 * count watchdog / brown-out resets, resume irrigation, clock goes
+		 * on; params are written only if this changed them
+		 */
+		if ((globals.reset & _BV(WDRF)) && globals.params.wdt_resets < 0xFF) {
+			globals.params.wdt_resets++;
+			changed = 1;
+		}
+		if ((globals.reset & _BV(BORF)) && globals.params.bor_resets < 0xFF) {
+			globals.params.bor_resets++;
+			changed = 1;
+		}
+		globals.warm = warm_init(globals.reset);
+		if (changed || globals.params.timestamp != timestamp) {
+			ee_defer(EE_PARAMS);
+		}
+	}
+	globals.osccal = OSCCAL;
+	if (globals.params.osccal != EEUNSET && OSCCAL_VALID(globals.params.osccal)) {
+		OSCCAL = globals.params.osccal;
 	}
+	profile_load();
 
 	/*
 	 * initialize i/o:
@@ -194,6 +354,8 @@ int main(void)
 
 	globals.dsp_stat = DSP_ON;
 	DS18x20_PWRINIT();
+	DS18x20_rdpower();	// external supply -> no precharge / strong pullup
+	DS18x20_readrom();	// sensor family -> conversion time, resolution
 	IRRI_INIT();
 	IRRI_OFF();
 	/*
@@ -203,6 +365,7 @@ int main(void)
 	TCCR0B = _BV(CS02) | _BV(CS00);	// 1024 prescaler
 	OCR0A = 99;
 	TIMSK |= _BV(OCIE0A);			// enable Timer/Counter0 compare interrupt
+	wdt_enable(WDT_TIMEOUT);		// reset by the tick ISR
 	sei();
 	/*
 	 * goto sleep
@@ -211,6 +374,8 @@ int main(void)
 	sleep_enable();
 	while (1)
 	{
-		sleep_cpu();
+		if (!ee_flush()) {	// eeprom writes deferred by the tick ISR
+			sleep_cpu();
+		}
 	}
 }
@@ -9,10 +9,12 @@
 #ifndef FROSTGUARD_H_
 #define FROSTGUARD_H_
 
+#include "irrigation.h"
+
 /**
  * timer ISR(TIM0_COMPA_vect)@100[ms] related stuff
  */
-#define CONVERSION_TIME (((DS18x20_CVT / 100) * 100) < DS18x20_CVT ? (DS18x20_CVT / 100) + 1 : (DS18x20_CVT / 100))
+#define CONVERSION_TIME conversion_time		// runtime value, ticks of sensor conversion time (mode_watch.c)
 
 #define ONE_SECOND		10
 #define TEN_SECONDS		100
@@ -20,17 +22,94 @@
 #define SIXTY_SECONDS	600
 
 /**
- * modes of the state machine
- */
-#define MODE_UNSET	0		// no mode set
-#define MODE_RESET	_BV(0)	// power on
-#define MODE_TEMPS	_BV(1)	// set temperatures
-#define MODE_DATIME	_BV(2)	// set date/time
-#define MODE_WATCH	_BV(3)	// watch temperature
-#define MODE_MENU	_BV(4)	// menu
-#define MODE_IRRIG	_BV(5)	// manual irrigation
-#define MODE_BRIGHT	_BV(6)	// set brightness
-#define MODE_DATA	_BV(7)	// retrieve irrigation data
+ * temperature cache (mode_watch.c): the measurement interval is limited to
+ * CACHE_MAX_AGE [s], a reading older than CACHE_FRESH [s] is shown blinking
+ * and KEY_SET starts a new measurement
+ */
+#ifndef CACHE_MAX_AGE
+#define CACHE_MAX_AGE	120
+#endif
+#if DEFAULT_INTERVAL_MAX > CACHE_MAX_AGE
+#error DEFAULT_INTERVAL_MAX above CACHE_MAX_AGE
+#endif
+#define CACHE_FRESH		15
+
+/**
+ * sensor faults (mode_watch.c): failed readings are retried at once in
+ * bursts of SENSOR_BURST, bursts every interval_min seconds; after
+ * SENSOR_FAIL_LIMIT failed readings in a row a fault event is logged and
+ * the relay follows params.fail_policy until the next valid reading
+ */
+#define SENSOR_BURST		3
+#define SENSOR_FAIL_LIMIT	6
+
+#define FAIL_KEEP		0	// keep pulsing the last irrigation mode
+#define FAIL_IRRIGATE	1	// relay constant on
+#define FAIL_STOP		2	// relay off
+#define DEFAULT_FAIL_POLICY	FAIL_KEEP
+
+#define FAULT_RESET		1	// fault causes: no sensor reset
+#define FAULT_DATA		2	// no sensor data
+#define FAULT_RANGE		3	// temperature out of range
+#define EVENT_FAULT		0x80	// event irri_mode: fault event, cause in low bits
+
+/**
+ * telemetry record flags (mode_data.c)
+ */
+#define TLM_RELAY		_BV(0)	// relay on
+#define TLM_FAULT		_BV(1)	// last reading failed
+#define TLM_FAILSAFE	_BV(2)	// sensor fault policy active
+#define TLM_VCC			_BV(3)	// supply voltage safe state
+
+/**
+ * runtime checks of the tick ISR (frostguard.c), CHECK_INVARIANTS 0 = off
+ *
+ * violations are repaired where possible and collected in
+ * globals.check.violations, the worst-case ISR time (without MODE_DATA,
+ * which sends the export within the tick) is kept with its mode
+ */
+#ifndef CHECK_INVARIANTS
+#define CHECK_INVARIANTS	1
+#endif
+
+#define INV_MODE		_BV(0)	// mode out of range -> MODE_WATCH
+#define INV_RELAY		_BV(1)	// relay on outside MODE_WATCH / MODE_IRRIG -> off
+#define INV_PARAMS		_BV(2)	// params out of bounds in MODE_WATCH -> defaults
+#define INV_OVERRUN		_BV(3)	// tick ISR longer than the tick
+
+/**
+ * watchdog and warm restart (mode_watch.c)
+ *
+ * the watchdog is reset by the tick ISR (and per record of the export);
+ * after a watchdog or brown-out reset the watch mode irrigation state kept
+ * in .noinit RAM resumes the relay pulses at once, at most WARM_RETRIES
+ * times in a row without a valid reading
+ */
+#define WDT_TIMEOUT		WDTO_2S	// export and sync measurement stay below
+#define WARM_MAGIC		0xA5	// crc8 start value, zeroed RAM is not valid
+#define WARM_RETRIES	2
+
+/**
+ * oscillator calibration (serial command 'o'): a calibrated OSCCAL value is
+ * used only within OSCCAL_RANGE steps of the factory value globals.osccal
+ */
+#define OSCCAL_RANGE	16
+#define OSCCAL_VALID(cal)	((uint8_t)((cal) - globals.osccal + OSCCAL_RANGE) <= 2 * OSCCAL_RANGE)
+
+/**
+ * modes of the state machine (index of mode function table in frostguard.c,
+ * mask bit _BV(MODE_xxx))
+ */
+#define MODE_RESET	0	// power on
+#define MODE_TEMPS	1	// set temperatures
+#define MODE_DATIME	2	// set date/time
+#define MODE_WATCH	3	// watch temperature
+#define MODE_MENU	4	// menu
+#define MODE_IRRIG	5	// manual irrigation
+#define MODE_BRIGHT	6	// set brightness
+#define MODE_DATA	7	// retrieve irrigation data
+
+#define TABLE_MODES	(_BV(MODE_RESET) | _BV(MODE_TEMPS) | _BV(MODE_DATIME) | _BV(MODE_MENU) | _BV(MODE_BRIGHT))	// mode_table.c
 
 #define SUBMODE_EXIT	99	// submode: exit mode
 /*
@@ -39,6 +118,15 @@
 #define MDS_RUN		0
 #define MDS_DONE	1
 
+/*
+ * state table hook events (mode_table.c)
+ */
+#define HOOK_ENTER	0	// state entered
+#define HOOK_CHANGE	1	// value changed
+#define HOOK_DONE	2	// KEY_SET in last state
+#define HOOK_EXIT	3	// mode left
+#define HOOK_MAX	4	// return max value
+
 /**
  * key codes from TM1637_keyscan()
  */
@@ -50,6 +138,19 @@
 #define KEY_DOWN_L	0x66	// key DOWN long hold
 #define KEY_SET_L	0x55	// key SET long hold
 
+/**
+ * key long hold / auto-repeat timing [ticks]
+ *
+ * long hold after KEY_REPEAT_MAX, then KEY_UP/KEY_DOWN repeat in the
+ * setting modes: period KEY_REPEAT_SLOW, decremented all KEY_REPEAT_ACCEL
+ * repeats down to KEY_REPEAT_FAST
+ */
+#define KEY_REPEAT_MAX		4
+#define KEY_REPEAT_SLOW		4
+#define KEY_REPEAT_FAST		1
+#define KEY_REPEAT_ACCEL	4
+#define KEY_REPEAT_MODES	TABLE_MODES	// setting modes of the table driver
+
 /**
  * display status
  */
@@ -63,6 +164,9 @@
 #define IRRI_INIT()		(DDRB |= _BV(DDB2))
 #define	IRRI_ON()		(PORTB &= ~_BV(PB2))
 #define	IRRI_OFF()		(PORTB |= _BV(PB2))
+#define	IRRI_IS_ON()	(!(PORTB & _BV(PB2)))
+
+#define NIGHT_START		(12 * 60 * 60UL)	// irrigation nights run from noon to noon [s of day]
 
 /**
  * brightness (0...TM1637_BRIGHTNESS_MAX)
@@ -75,23 +179,56 @@
  */
 #define BINTEMP(x)	(x * 2)
 
+/**
+ * temperature duration histogram (mode_data.c)
+ *
+ * HISTO_BINS bins of 0.5[] starting at params.histo_base, the outer bins
+ * collect all temperatures below / above. Minutes are buffered in RAM and
+ * written to eeprom when a bin collected HISTO_BATCH [min], readings more
+ * than HISTO_GAP [s] apart are not counted
+ */
+#define DEFAULT_HISTO_BASE	BINTEMP(-3.0)
+#define HISTO_BATCH		60
+#define HISTO_GAP		600
+
 /**
  * mode and mode related functions
  *
  * all mode functions return 1 for mode done / 0 for mode not done
  */
-uint8_t	mode_temperatures(uint8_t key);	// mode_temp.c - set temperatures
-void	displayTemp(int16_t temperature);
-uint8_t *num_2_value(int16_t num, uint8_t sign, uint8_t ascii, uint8_t dot);
-uint8_t *temp_2_value(int16_t temperature, uint8_t ascii);
-uint8_t	mode_datetime(uint8_t key);		// mode_datetime.c - set date and time
-void update_datetime();
+uint8_t	mode_table(uint8_t key);		// mode_table.c - menu, brightness, temperatures, date/time
+uint8_t table_state();
+void	displayTemp(int16_t temperature);	// mode_temp.c - temperature display / conversion
+uint8_t *num_2_value(int16_t num, uint8_t sign, uint8_t ascii, uint8_t dot);
+uint8_t *temp_2_value(int16_t temperature, uint8_t ascii);
+typedef struct
+{
+	uint8_t	year;	// since 1970
+	uint8_t	month, day, hour, min, sec;
+
+} datetime_t;
+extern datetime_t datetime;				// mode_datetime.c - date and time
+uint8_t datetime_hook(uint8_t event);
+uint8_t year_hook(uint8_t event);
+void showDateTime(uint8_t first, uint8_t second);
 char *timestamp_2_string(uint32_t ts);
 uint8_t	mode_watch(uint8_t key);		// mode_watch.c - watch / show temperature 
-uint8_t	mode_menu(uint8_t key);			// mode_menu.c - menu selection
-uint8_t	mode_brightness(uint8_t key);	// mode_brightness.c
+extern irri_t irri;
+extern uint8_t conversion_time;
+void profile_load();
+uint16_t tcache_age();
+uint8_t warm_init(uint8_t mcusr);
 uint8_t	mode_irrigate(uint8_t key);		// mode_irrigate.c
+void irrigation(uint8_t on);
+void irrigation_night();
+void irrigation_save();
 uint8_t	mode_data(uint8_t key);			// mode_data.c - transfer data
-void store_event(int16_t temp, uint8_t irri_mode);
+void store_event(int16_t temp, uint8_t irri_mode, uint8_t eta);
+void store_fault(uint8_t cause);
+void telemetry(uint8_t flags);
+void histogram(int8_t temp);
+void histogram_flush();
+void histogram_clear();
+void day_index_clear();
 
 #endif /* FROSTGUARD_H_ */
\ No newline at end of file
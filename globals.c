@@ -7,9 +7,12 @@
  */ 
 
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include "frostguard.h"
 #include "tm1637.h"
-#include "globals.h"
+#include "globals.h"
+#include "vcc.h"
 
 /**
  * globals
@@ -24,8 +27,25 @@ globals_t globals = {
 
 eedata_t EEMEM eedata = {
 	.params = {
+		.layout = PARAMS_LAYOUT,
 		.brightness = 0xFF,
 		.write = 0,
+		.exported = 0,
+		.head = 0,
+		.lost = 0,
+		.osccal = EEUNSET,
+		.lead = DEFAULT_LEAD,
+		.interval_min = DEFAULT_INTERVAL_MIN,
+		.interval_max = DEFAULT_INTERVAL_MAX,
+		.summaries = 0,
+		.histo_base = DEFAULT_HISTO_BASE,
+		.vcc_low = DEFAULT_VCC_LOW,
+		.vcc_min = EEUNSET,
+		.fail_policy = DEFAULT_FAIL_POLICY,
+		.telemetry = 0,
+		.unit = 0,
+		.wdt_resets = 0,
+		.bor_resets = 0,
 		.timestamp = DT_2021_4_5_12_0_0,
 		.temperatures = { 
 			.high = 0xFF, 
@@ -35,14 +55,102 @@ eedata_t EEMEM eedata = {
 			.high = 0xFF,
 			.low = 0xFF
 		}
-	}
+	},
+	.profile = {	// irrigation mode n: 60[s] on / (n - 1) x 30[s] off
+		{ 6, 0 }, { 6, 3 }, { 6, 6 }, { 6, 9 }, { 6, 12 }, { 6, 15 }, { 6, 18 }, { 6, 21 }
+	},
+#if TRACE_DEPTH > 0
+	.trace = {
+		.cause = EEUNSET	// no trace frozen
+	},
+#endif
 };
 
+void ee_update(const void *src, void *dst, size_t n)
+{
+	if (!globals.vcc_safe) {
+		eeprom_update_block(src, dst, n);
+	}
+}
+
+volatile uint8_t ee_pending;	// EE_xxx blocks marked by ee_defer()
+
+/**
+ * deferred eeprom write, called by the main loop
+ *
+ * writes one changed byte of the blocks marked by ee_defer() per call, the
+ * tick ISR runs in between. A block is done after a pass without a changed
+ * byte, so a change by the ISR during the pass (timestamp) is written too.
+ * Nothing is written in the supply voltage safe state (the blocks stay
+ * pending) but the blocks closed by ee_close() on entering it. Returns 0
+ * if there is nothing to write.
+ */
+uint8_t ee_flush()
+{
+	static uint8_t block;		// EE_xxx written, 0 = none
+	static uint8_t offset;		// next byte of block
+	static uint8_t changed;		// bytes written in this pass
+	register const uint8_t *src;
+	register uint8_t *dst;
+	register uint8_t size, pending;
+
+	if (globals.vcc_safe && !(ee_pending & EE_CLOSE)) {
+		return 0;
+	}
+	if (block == 0) {
+		cli();
+		pending = ee_pending & ~EE_CLOSE;
+		block = pending & (uint8_t)-pending;	// lowest pending block
+		ee_pending = block == 0 ? 0 : ee_pending & ~block;
+		sei();
+		if (block == 0) {
+			return 0;
+		}
+		offset = 0;
+		changed = 0;
+	}
+	if (block == EE_PARAMS) {
+		src = (const uint8_t *)&globals.params;
+		dst = (uint8_t *)&eedata.params;
+		size = sizeof(params_t);
+	} else if (block == EE_RELAY) {
+		src = (const uint8_t *)&globals.relay;
+		dst = (uint8_t *)&eedata.relay;
+		size = sizeof(relay_t);
+	} else {
+		src = (const uint8_t *)globals.days;
+		dst = (uint8_t *)eedata.days;
+		size = sizeof(globals.days);
+	}
+	while (offset < size) {
+		eeprom_busy_wait();
+		cli();				// no eeprom access of the ISR between read and write
+		pending = src[offset];
+		if (eeprom_read_byte(dst + offset) != pending) {
+			eeprom_write_byte(dst + offset, pending);
+			changed++;
+			offset++;
+			sei();
+			return 1;
+		}
+		sei();
+		offset++;
+	}
+	if (changed > 0) {
+		offset = 0;		// next pass
+		changed = 0;
+	} else {
+		block = 0;
+	}
+	return 1;
+}
+
+
 /**
  * messages for menus et.al.
  */
-const uint8_t messages[] = {
-// menu messages - keep at begin of array and in order (see mode_menu.c)
+const uint8_t messages[] PROGMEM = {
+// menu messages - keep at begin of array and in order (see mode_table.c)
 	0x0D,		0x0A,		_DSP_t,		0x0A,		// dAtA
 	_DSP_i,		_DSP_r,		_DSP_r,		_DSP_i,		// irri
 	0x0B,		_DSP_r,		_DSP_i,		_DSP_BLANK,	// bri_
@@ -55,5 +163,8 @@ const uint8_t messages[] = {
 	0x0C,		_DSP_L,		_DSP_r,		_DSP_BLANK,	// CLr_
 	_DSP_r,		0x0E,		_DSP_t,		_DSP_BLANK,	// rEt_
 	_DSP_n,		_DSP_o,		_DSP_BLANK,	0x0D,		// no_d
-	_DSP_n,		_DSP_o,		_DSP_BLANK,	_DSP_r		// no_r
+	_DSP_n,		_DSP_o,		_DSP_BLANK,	_DSP_r,		// no_r
+	_DSP_n,		0x0E,		_DSP_u,		_DSP_BLANK,	// nEu_
+	_DSP_L,		_DSP_o,		_DSP_BLANK,	_DSP_U,		// Lo_U
+	_DSP_L,		0x05,		_DSP_t,		_DSP_BLANK	// LSt_ (+ digit)
 };
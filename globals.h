@@ -9,6 +9,7 @@
 #define GLOBALS_H_
 
 #include <avr/eeprom.h>
+#include "irrigation.h"
 
 /**
  * data types
@@ -22,11 +23,28 @@ typedef struct
 
 typedef struct params		// runtime parameters / copy in eeprom
 {
+	uint8_t			layout;			// PARAMS_LAYOUT, other = eeprom data of another firmware
 	temperatures_t	temperatures;	// threshold temperatures
 	temperatures_t	minmax;			// min/max temperatures
 	uint32_t		timestamp;		// reference January 1st, 1970, 00:00:00 in [s]
 	uint8_t			brightness;
-	int8_t			write;			// event data eeprom write index
+	int8_t			write;			// event data eeprom write index (events stored)
+	int8_t			exported;		// event data exported up to (excluding) this index
+	uint8_t			head;			// event ring index of the oldest event (index 0)
+	uint8_t			lost;			// events dropped before export or summary (saturating)
+	uint8_t			osccal;			// calibrated OSCCAL value (EEUNSET = factory value)
+	uint8_t			lead;			// predictive irrigation start lead time [min] (0 = off)
+	uint8_t			interval_min;	// measurement interval min [s]
+	uint8_t			interval_max;	// measurement interval max [s]
+	uint8_t			summaries;		// episode summaries written (ring index = summaries % MAX_SUMMARIES)
+	int8_t			histo_base;		// binary temperature of first histogram bin
+	uint8_t			vcc_low;		// supply voltage safe state threshold [VCC_UNIT] (0 = off)
+	uint8_t			vcc_min;		// supply voltage min [VCC_UNIT]
+	uint8_t			fail_policy;	// relay on sensor fault FAIL_xxx
+	uint8_t			telemetry;		// 1 = telemetry record after each measurement
+	uint8_t			unit;			// unit id of the export (fleet ingestion)
+	uint8_t			wdt_resets;		// watchdog resets (saturating)
+	uint8_t			bor_resets;		// brown-out resets (saturating)
 		
 } params_t;
 
@@ -37,15 +55,142 @@ typedef struct		// irrigation event data
 	uint32_t	timestamp;	// 1[s] resolution timestamp since 1970-01-01 00:00:00
 	int8_t		temp;		// binary temperature 0.5[] resolution
 	uint8_t		irri_mode;	// irrigation mode
+	uint8_t		eta;		// predicted low threshold crossing in [min] (0 = none)
 	
 } event_t;
 
+typedef struct		// irrigation pulse profile of one irrigation mode
+{
+	uint8_t		on;			// on phase [10s]
+	uint8_t		off;		// off phase [10s], 0 = constant on
+	
+} profile_t;
+
+typedef struct		// irrigation relay accounting
+{
+	uint32_t	night;		// start of irrigation night, timestamp [s]
+	uint32_t	on_total;	// relay on time total [s]
+	uint32_t	on_night;	// relay on time of irrigation night [s]
+	uint16_t	sw_total;	// relay actuations total
+	uint16_t	sw_night;	// relay actuations of irrigation night
+	
+} relay_t;
+
+typedef struct		// frost episode summary (first event to irrigation stop)
+{
+	uint32_t	start;		// timestamp of first event [s]
+	uint16_t	duration;	// episode duration [min]
+	uint16_t	irrigation;	// relay on time [min]
+	int8_t		temp;		// min binary temperature 0.5[] resolution
+	uint8_t		irri_mode;	// peak irrigation mode
+	
+} summary_t;
+
+typedef struct		// running frost episode (RAM only)
+{
+	uint32_t	start;		// timestamp of first event [s], 0 = no episode
+	uint32_t	on_total;	// relay on time total at episode start [s]
+	int8_t		temp;		// min binary temperature
+	uint8_t		irri_mode;	// peak irrigation mode
+	
+} episode_t;
+
+typedef struct		// day index entry
+{
+	uint16_t	day;		// day number since 1970-01-01 (timestamp / DAY_SECONDS), DAY_UNSET = unused
+	uint8_t		first;		// event index of first event of the day
+	
+} daymark_t;
+
+#define DAY_SECONDS	(24 * 60 * 60UL)
+#define DAY_UNSET	0xFFFF
+#define DAY_INDEX	4		// days with events in the day index
+
+typedef struct		// temperature cache, last valid reading of watch mode (RAM only)
+{
+	uint32_t	stamp;		// timestamp of reading [s]
+	int8_t		value;		// binary temperature 0.5[] resolution
+	uint8_t		valid;		// 0 = no reading yet
+	
+} tcache_t;
+
+typedef struct		// sensor fault counters (RAM only)
+{
+	uint16_t	retries;	// failed readings
+	uint8_t		faults;		// fail-safe entered (SENSOR_FAIL_LIMIT failed readings in a row)
+	uint8_t		recoveries;	// valid reading after failed readings
+	
+} faults_t;
+
+typedef struct		// runtime checks (RAM only, CHECK_INVARIANTS)
+{
+	uint8_t		violations;	// INV_xxx seen
+	uint8_t		isr_max;	// worst-case tick ISR time [1024us] (TCNT0)
+	uint8_t		isr_mode;	// mode of the worst-case tick
+	uint8_t		overruns;	// tick ISR longer than the tick
+	
+} check_t;
+
+typedef struct		// watch mode irrigation state (.noinit RAM, kept over a reset)
+{
+	uint32_t	timestamp;	// clock [s]
+	int8_t		filtered;	// filtered binary temperature
+	uint8_t		irri_mode;	// irrigation mode, 0 = nothing to resume
+	uint8_t		pulse_timer;	// PULSE_xxx
+	uint16_t	irri_timer;	// ticks left of pulse phase
+	uint8_t		restarts;	// warm restarts without a valid reading since
+	uint8_t		check;		// checksum (WARM_MAGIC + crc8)
+	
+} warm_t;
+
+/**
+ * state transition trace (trace.h), TRACE_DEPTH entries (power of 2),
+ * 0 = no trace
+ */
+#ifndef TRACE_DEPTH
+#define TRACE_DEPTH	4
+#endif
+
+#if TRACE_DEPTH > 0
+typedef struct		// trace entry
+{
+	uint16_t	tick;		// timestamp [s], low word
+	uint8_t		mode;		// globals.mode, 0xFF = entry unused
+	uint8_t		submode;	// globals.submode
+	uint8_t		key;		// key of dispatcher call
+	int8_t		temp;		// last binary temperature of watch mode
+	uint8_t		irri_mode;	// last irrigation mode of watch mode
+	
+} trace_t;
+
+typedef struct		// trace frozen on watchdog / brown-out reset
+{
+	uint8_t		cause;		// MCUSR of the reset, EEUNSET = none
+	trace_t		ring[TRACE_DEPTH];	// oldest first
+	
+} trace_ee_t;
+#define TRACE_EE_SIZE	sizeof(trace_ee_t)
+#else
+#define TRACE_EE_SIZE	0
+#endif
+
 /**
  * globals
  */
 typedef struct
 {
 	params_t	params;
+	relay_t		relay;
+	episode_t	episode;
+	tcache_t	tcache;
+	faults_t	faults;
+	check_t		check;
+	daymark_t	days[DAY_INDEX];	// day index (copy of eedata.days)
+	uint8_t		vcc;		// last supply voltage [VCC_UNIT], 0 = not measured
+	uint8_t		vcc_safe;	// 1 = supply voltage low, safe state
+	uint8_t		reset;		// MCUSR of the last reset
+	uint8_t		osccal;		// factory OSCCAL value
+	uint8_t		warm;		// 1 = irrigation resumed after watchdog / brown-out reset
 	uint8_t		mode;
 	uint8_t		submode;
 	uint8_t		blinker;
@@ -60,36 +205,70 @@ extern globals_t globals;
  * display messages for menus et.al.
  */
 extern const uint8_t messages[];
-// menu messages definitions - keep at begin and in order (see mode_menu.c)
-#define MSG_dAtA	((uint8_t *)(messages +  0))
-#define MSG_irri	((uint8_t *)(messages +  4))
-#define MSG_bri		((uint8_t *)(messages +  8))
-#define MSG_tEnP	((uint8_t *)(messages + 12))
-#define MSG_dAtE	((uint8_t *)(messages + 16))
+// menu messages definitions - keep at begin and in order (see mode_table.c)
+#define MSG_dAtA	((const uint8_t *)(messages +  0))
+#define MSG_irri	((const uint8_t *)(messages +  4))
+#define MSG_bri		((const uint8_t *)(messages +  8))
+#define MSG_tEnP	((const uint8_t *)(messages + 12))
+#define MSG_dAtE	((const uint8_t *)(messages + 16))
 // end of menu messages - other messages
-#define MSG_SEnd	((uint8_t *)(messages + 20))
-#define MSG_on		((uint8_t *)(messages + 24))
-#define MSG_oFF		((uint8_t *)(messages + 28))
-#define MSG_CLr		((uint8_t *)(messages + 32))
-#define MSG_rEt		((uint8_t *)(messages + 36))
-#define MSG_no_d	((uint8_t *)(messages + 40))
-#define MSG_no_r	((uint8_t *)(messages + 44))
+#define MSG_SEnd	((const uint8_t *)(messages + 20))
+#define MSG_on		((const uint8_t *)(messages + 24))
+#define MSG_oFF		((const uint8_t *)(messages + 28))
+#define MSG_CLr		((const uint8_t *)(messages + 32))
+#define MSG_rEt		((const uint8_t *)(messages + 36))
+#define MSG_no_d	((const uint8_t *)(messages + 40))
+#define MSG_no_r	((const uint8_t *)(messages + 44))
+#define MSG_nEu		((const uint8_t *)(messages + 48))
+#define MSG_Lo_U	((const uint8_t *)(messages + 52))
+#define MSG_LSt		((const uint8_t *)(messages + 56))
 
 /**
  * eeprom data
  */
 #define EEPROM_SIZE	(E2END + 1)
-#define MAX_EVENTS	((EEPROM_SIZE - sizeof(params_t) - sizeof(int8_t)) / sizeof(event_t))
+#define MAX_SUMMARIES	16
+#define HISTO_BINS		16
+#define MAX_EVENTS	((EEPROM_SIZE - sizeof(params_t) - PROFILE_BANDS * sizeof(profile_t) - sizeof(relay_t) - MAX_SUMMARIES * sizeof(summary_t) - HISTO_BINS * sizeof(uint16_t) - TRACE_EE_SIZE - DAY_INDEX * sizeof(daymark_t) - sizeof(int8_t)) / sizeof(event_t))
 
 #define EEUNSET	0xFF	// eeprom data unset
+#define PARAMS_LAYOUT	0xC4	// eeprom layout version, change with eedata_t
 
 typedef struct
 {
 	params_t	params;
+	profile_t	profile[PROFILE_BANDS];	// pulse profile for irrigation mode 1...PROFILE_BANDS
+	relay_t		relay;
+	summary_t	summaries[MAX_SUMMARIES];	// ring of frost episode summaries
+	uint16_t	histogram[HISTO_BINS];		// temperature duration [min] per 0.5[] bin
+#if TRACE_DEPTH > 0
+	trace_ee_t	trace;
+#endif
+	daymark_t	days[DAY_INDEX];			// first event of the last days with events, oldest first
 	event_t		events[MAX_EVENTS];
 
 } eedata_t;
 
 extern eedata_t EEMEM eedata;
 
+/**
+ * eeprom write (eeprom_update_block()), skipped in the supply voltage safe
+ * state globals.vcc_safe - all eeprom writes go here
+ */
+void ee_update(const void *src, void *dst, size_t n);
+
+/**
+ * deferred eeprom write of the RAM copies: the tick ISR only marks the
+ * block (ee_defer()), the main loop writes its changed bytes (ee_flush())
+ */
+#define EE_PARAMS	0x01	// globals.params -> eedata.params
+#define EE_RELAY	0x02	// globals.relay -> eedata.relay
+#define EE_DAYS		0x04	// globals.days -> eedata.days
+#define EE_CLOSE	0x80	// write the blocks in the safe state too
+
+extern volatile uint8_t ee_pending;
+#define ee_defer(blocks)	(ee_pending |= (blocks))
+#define ee_close()			ee_defer(EE_PARAMS | EE_RELAY | EE_DAYS | EE_CLOSE)
+uint8_t ee_flush(void);
+
 #endif /* GLOBALS_H_ */
\ No newline at end of file
@@ -0,0 +1,289 @@
+/*
+ * irrigation.c
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ */
+#include <stdint.h>
+#include "irrigation.h"
+
+/**
+ * reset filter, trend and pulse timer (settings and counters are kept)
+ */
+void irri_init(irri_t *irri)
+{
+	irri->sample_cnt = irri->sample_idx = 0;
+	irri->history_cnt = irri->history_idx = 0;
+	irri->irri_mode = irri->raw_mode = irri->eta = 0;
+	irri->raw_last = IRRI_NO_EVENT;
+	irri->pulse_timer = PULSE_STOP;
+	irri->irri_timer = 0;
+}
+
+/**
+ * temperature filter - median, moving average and hysteresis
+ *
+ * returns filtered binary temperature
+ */
+static int8_t filter(irri_t *irri, int8_t t)
+{
+	int8_t sorted[FILTER_MEDIAN];
+	register uint8_t i, j;
+	register int8_t s;
+	register int16_t diff;
+
+	irri->samples[irri->sample_idx] = t;
+	if (++irri->sample_idx == FILTER_MEDIAN) {
+		irri->sample_idx = 0;
+	}
+	if (irri->sample_cnt < FILTER_MEDIAN) {
+		irri->sample_cnt++;
+	}
+	// insertion sort of ring samples for median
+	for (i = 0; i < irri->sample_cnt; i++) {
+		s = irri->samples[i];
+		for (j = i; j > 0 && sorted[j - 1] > s; j--) {
+			sorted[j] = sorted[j - 1];
+		}
+		sorted[j] = s;
+	}
+	s = sorted[irri->sample_cnt / 2];
+
+	if (irri->sample_cnt == 1) {
+		irri->average = (int16_t)s << 4;
+		irri->filtered = s;
+	} else {
+		irri->average += (((int16_t)s << 4) - irri->average) >> FILTER_EMA_SHIFT;
+		diff = irri->average - ((int16_t)irri->filtered << 4);
+		if (diff > 8 + FILTER_HYST || diff < -(8 + FILTER_HYST)) {
+			irri->filtered = (int8_t)((irri->average + 8) >> 4);
+		}
+	}
+	return irri->filtered;
+}
+
+/**
+ * temperature trend - least squares fit over history (time x in 10[s] units
+ * relative to now, temperature y in 1/16 binary temperature):
+ *
+ *   slope = (n * Sxy - Sx * Sy) / (n * Sxx - Sx * Sx) = num / den
+ *
+ * the slope is only used within irri_sample(), it is kept on the stack
+ */
+typedef struct
+{
+	int32_t		num;
+	int32_t		den;
+
+} trend_t;
+
+static void trend(irri_t *irri, trend_t *tr, int16_t y, uint16_t now)
+{
+	register uint8_t i, n = 0;
+	register int16_t x;
+	int32_t sx = 0, sy = 0, sxx = 0, sxy = 0;
+
+	irri->history[irri->history_idx].time = now;
+	irri->history[irri->history_idx].temp = y;
+	if (++irri->history_idx == PREDICT_SAMPLES) {
+		irri->history_idx = 0;
+	}
+	if (irri->history_cnt < PREDICT_SAMPLES) {
+		irri->history_cnt++;
+	}
+	for (i = 0; i < irri->history_cnt; i++) {
+		if ((uint16_t)(now - irri->history[i].time) <= PREDICT_SPAN) {
+			x = -(int16_t)((uint16_t)(now - irri->history[i].time) / 10);
+			sx += x;
+			sy += irri->history[i].temp;
+			sxx += (int32_t)x * x;
+			sxy += (int32_t)x * irri->history[i].temp;
+			n++;
+		}
+	}
+	tr->num = n < 3 ? 0 : n * sxy - sx * sy;
+	tr->den = n * sxx - sx * sx;
+}
+
+/**
+ * time in 10[s] units until the temperature trend falls from y to level
+ * (both 1/16 binary temperature), TREND_NONE if not falling or below level
+ */
+#define TREND_NONE	0xFFFF
+
+static uint16_t trend_eta(const trend_t *tr, int16_t y, int16_t level)
+{
+	register int32_t eta;
+
+	if (tr->num >= 0 || tr->den <= 0 || y <= level) {
+		return TREND_NONE;
+	}
+	eta = (int32_t)(y - level) * tr->den / -tr->num;
+	return eta < TREND_NONE ? (uint16_t)eta : TREND_NONE - 1;
+}
+
+/**
+ * predict low threshold crossing from averaged temperature y
+ *
+ * returns predicted time to crossing in [min] (rounded up) if within
+ * lead, 0 otherwise
+ */
+static uint8_t predict(irri_t *irri, const trend_t *tr, int16_t y)
+{
+	register uint16_t eta = trend_eta(tr, y, (int16_t)irri->cfg.low << 4);
+
+	if (   irri->cfg.lead == 0 || eta == TREND_NONE
+		|| y > ((int16_t)irri->cfg.high << 4)) {
+		return 0;
+	}
+	eta = eta / 6 + 1;	// 10[s] -> [min]
+	return eta <= irri->cfg.lead ? (uint8_t)eta : 0;
+}
+
+/**
+ * measurement period in ticks from temperature margin and trend
+ *
+ * - irrigating or at/below high threshold -> interval_min
+ * - INTERVAL_STEP [s] per 0.5 step above high threshold, limited to 1/4 of
+ *   the predicted time to reach the high threshold temperature
+ * - bounded by interval_min / interval_max
+ */
+static uint16_t measure_interval(irri_t *irri, const trend_t *tr, int16_t y)
+{
+	register int16_t margin = irri->filtered - irri->cfg.high;
+	register uint16_t secs = irri->cfg.interval_min;
+	register uint16_t eta;
+
+	if (irri->irri_mode == 0 && margin > 0) {
+		secs += (uint16_t)margin * INTERVAL_STEP;
+		eta = trend_eta(tr, y, (int16_t)irri->cfg.high << 4);
+		if (eta != TREND_NONE && secs > eta / 4 * 10) {
+			secs = eta / 4 * 10;
+		}
+		if (secs > irri->cfg.interval_max) {
+			secs = irri->cfg.interval_max;
+		}
+		if (secs < irri->cfg.interval_min) {
+			secs = irri->cfg.interval_min;
+		}
+	}
+	return secs * IRRI_TICKS;
+}
+
+/**
+ * irrigation mode from binary temperature
+ *
+ * - t > high -> 0 (stop)
+ * - t <= low -> 1 (start)
+ * - else -> unchanged if 0, otherwise 0.5 steps above low + 1
+ */
+static uint8_t irrigation_mode(irri_t *irri, int8_t t, uint8_t mode)
+{
+	if (t > irri->cfg.high) {
+		mode = 0;
+	} else if (t <= irri->cfg.low) {
+		mode = 1;
+	} else if (mode >= 1) {
+		mode = t - irri->cfg.low + 1;
+	}
+	return mode;
+}
+
+/**
+ * process temperature sample t taken at now [s] (low word)
+ *
+ * - filter temperature, calculate irrigation mode from filtered temperature
+ *   and count the event writes the unfiltered temperature would cause
+ *   (compare with flt_writes counted by the caller per event written)
+ * - start pulse irrigation early if the temperature trend predicts the
+ *   low threshold temperature within lead minutes
+ * - (re)start pulse timer with the on phase on irrigation start and on
+ *   entering mode 1
+ *
+ * returns ticks until next sample
+ */
+uint16_t irri_sample(irri_t *irri, int8_t t, uint16_t now)
+{
+	register uint8_t mode = irrigation_mode(irri, filter(irri, t), irri->irri_mode);
+	register uint8_t mode_raw = irrigation_mode(irri, t, irri->raw_mode);
+	trend_t tr;
+
+	trend(irri, &tr, irri->average, now);
+	irri->eta = predict(irri, &tr, irri->average);
+
+	if (mode_raw == 0 && irri->eta > 0) {
+		mode_raw = irrigation_mode(irri, t, 1);	// same predicted start, filter effect only
+	}
+	if (irri_log(&irri->cfg, t, mode_raw, irri->raw_temp, irri->raw_last)) {
+		irri->raw_temp = t;
+		irri->raw_last = mode_raw;
+		irri->flt_raw++;
+	}
+	irri->raw_mode = mode_raw;
+	if (mode == 0 && irri->eta > 0) {
+		// predicted crossing of low temperature: start pulse irrigation
+		mode = irrigation_mode(irri, irri->filtered, 1);
+	}
+	if (mode == 0) {
+		irri->pulse_timer = PULSE_STOP;
+	} else if (mode != irri->irri_mode && (mode == 1 || irri->irri_mode == 0)) {
+		// (re)start irrigation with on phase
+		irri->pulse_timer = PULSE_START;
+	}
+	irri->irri_mode = mode;
+	return measure_interval(irri, &tr, irri->average);
+}
+
+/**
+ * pulse irrigation from irri_mode by profile lookup table, called each tick
+ * (irri_mode > PROFILE_BANDS uses last entry), default:
+ *
+ *   0: off
+ *   1: constant on
+ *   2: 60[s] on /     30[s] off
+ *   3: 60[s] on / 2 x 30[s] off
+ *   4: 60[s] on / 3 x 30[s] off
+ *   ...
+ *
+ * returns relay state (1 = on)
+ */
+uint8_t irri_pulse(irri_t *irri)
+{
+	if (irri->pulse_timer == PULSE_STOP) {
+		// stop pulse timer
+		irri->irri_timer = 0;
+	} else if (irri->pulse_timer == PULSE_START || irri->irri_timer == 0) {
+		register uint8_t band = (irri->irri_mode > PROFILE_BANDS ? PROFILE_BANDS : irri->irri_mode) - 1;
+
+		if (irri->pulse_timer == PULSE_ON && irri->cfg.pulse_off[band] != 0) {
+			// off phase
+			irri->irri_timer = irri->cfg.pulse_off[band] * PULSE_UNIT;
+			irri->pulse_timer = PULSE_OFF;
+		} else {
+			// on phase
+			irri->irri_timer = irri->cfg.pulse_on[band] * PULSE_UNIT;
+			irri->pulse_timer = PULSE_ON;
+		}
+	}
+	if (irri->irri_timer > 0) {
+		irri->irri_timer--;
+	}
+	return irri->pulse_timer == PULSE_ON;
+}
+
+/**
+ * event logging rule: log filtered temperature t / irrigation mode if
+ *
+ * - no event logged yet (last_mode == IRRI_NO_EVENT) and t at/below low
+ *   threshold or irrigating
+ * - temperature falls while irrigating or irrigation mode changes while
+ *   irrigating (including stop)
+ */
+uint8_t irri_log(const irri_config_t *cfg, int8_t t, uint8_t irri_mode, int8_t last_temp, uint8_t last_mode)
+{
+	if (last_mode == IRRI_NO_EVENT) {
+		return t <= cfg->low || irri_mode != 0;
+	}
+	return (t < last_temp && irri_mode > 0) || (last_mode != irri_mode && last_mode > 0);
+}
@@ -0,0 +1,119 @@
+/*
+ * irrigation.h
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ */ 
+
+#ifndef IRRIGATION_H_
+#define IRRIGATION_H_
+
+#include <stdint.h>
+
+/**
+ * irrigation core (irrigation.c)
+ *
+ * temperature filter, trend prediction, irrigation mode decision, pulse
+ * timing and event logging rule of the watch mode - hardware independent,
+ * used by mode_watch.c and the host replay tool (tools/replay.c)
+ *
+ * temperatures are binary temperatures (0.5[] resolution), time is counted
+ * in ticks of the 100[ms] timer ISR
+ */
+#define IRRI_TICKS		10	// ticks per [s] (ONE_SECOND)
+#define PROFILE_BANDS	8	// pulse profiles of irrigation mode 1...PROFILE_BANDS
+#define PULSE_UNIT		(10 * IRRI_TICKS)	// ticks per pulse profile unit (10[s], eeprom profile_t)
+
+/**
+ * temperature filter
+ *
+ * - median of FILTER_MEDIAN samples (1...7)
+ * - exponential moving average, weight 1/2^FILTER_EMA_SHIFT, calculated
+ *   in 1/16 binary temperature fixed point
+ * - hysteresis: the filtered temperature used for the irrigation decision
+ *   follows the average only if it differs by more than 1/2 binary
+ *   temperature + FILTER_HYST / 16
+ *
+ * tuned with tools/replay.c on sensor noise (replay -n 0.25 mode1.csv:
+ * 18 instead of 106 event writes, same min temperature irrigating); a
+ * slower average (FILTER_EMA_SHIFT 2) delays the predicted start and
+ * costs writes on noise free data
+ */
+#define FILTER_MEDIAN		5
+#define FILTER_EMA_SHIFT	1
+#define FILTER_HYST			4
+
+/**
+ * predictive irrigation start
+ *
+ * linear trend (least squares) over the last PREDICT_SAMPLES averaged
+ * temperatures within PREDICT_SPAN [s], the pulse irrigation starts if the
+ * low threshold temperature will be reached within params.lead [min]
+ */
+#define PREDICT_SAMPLES	4
+#define PREDICT_SPAN	1800
+#define DEFAULT_LEAD	10
+
+/**
+ * adaptive measurement interval
+ *
+ * INTERVAL_STEP [s] per 0.5[] above the high threshold temperature,
+ * bounded by params.interval_min...params.interval_max [s], the firmware
+ * limits interval_max to CACHE_MAX_AGE (frostguard.h)
+ */
+#define INTERVAL_STEP	15
+#define DEFAULT_INTERVAL_MIN	10
+#define DEFAULT_INTERVAL_MAX	120
+
+typedef struct		// irrigation settings (from params / eeprom profile)
+{
+	int8_t		low;			// threshold temperatures
+	int8_t		high;
+	uint8_t		lead;			// predictive start lead time [min] (0 = off)
+	uint8_t		interval_min;	// measurement interval bounds [s]
+	uint8_t		interval_max;
+	uint8_t		pulse_on[PROFILE_BANDS];	// pulse profile [PULSE_UNIT]
+	uint8_t		pulse_off[PROFILE_BANDS];	// 0 = constant on
+
+} irri_config_t;
+
+typedef struct		// irrigation state
+{
+	irri_config_t	cfg;
+	int8_t		samples[FILTER_MEDIAN];	// temperature filter ring
+	uint8_t		sample_idx;
+	uint8_t		sample_cnt;
+	int16_t		average;		// 1/16 binary temperature
+	int8_t		filtered;
+	struct {					// temperature trend history ring
+		uint16_t	time;		// timestamp [s] (low word)
+		int16_t		temp;		// 1/16 binary temperature
+	} history[PREDICT_SAMPLES];
+	uint8_t		history_idx;
+	uint8_t		history_cnt;
+	uint8_t		irri_mode;		// irrigation mode of filtered temperature
+	uint8_t		raw_mode;		// irrigation mode of unfiltered temperature
+	uint8_t		eta;			// predicted low threshold crossing [min] (0 = none)
+	uint8_t		pulse_timer;	// PULSE_xxx
+	uint16_t	irri_timer;		// ticks left of pulse phase
+	int8_t		raw_temp;		// last event of unfiltered temperature (irri_log)
+	uint8_t		raw_last;		// irrigation mode of this event, IRRI_NO_EVENT = none
+	uint16_t	flt_raw;		// event writes of unfiltered temperature
+	uint16_t	flt_writes;		// event writes of filtered temperature (counted by caller)
+
+} irri_t;
+
+#define PULSE_STOP	0	// pulse_timer states
+#define PULSE_START	1
+#define PULSE_ON	2
+#define PULSE_OFF	3
+
+void irri_init(irri_t *irri);
+uint16_t irri_sample(irri_t *irri, int8_t t, uint16_t now);
+uint8_t irri_pulse(irri_t *irri);
+#define IRRI_NO_EVENT	0xFF	// last_mode of irri_log(): no event logged yet
+
+uint8_t irri_log(const irri_config_t *cfg, int8_t t, uint8_t irri_mode, int8_t last_temp, uint8_t last_mode);
+
+#endif /* IRRIGATION_H_ */
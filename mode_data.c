@@ -7,31 +7,75 @@
  *
  */ 
 #include <stdint.h>
+#include <string.h>
+#include <avr/pgmspace.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <util/delay.h>
-#include <avr/sleep.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include <util/crc16.h>
 #include "ds18x20.h"
 #include "tm1637.h"
 #include "frostguard.h"
 #include "globals.h"
 #include "uart.h"
+#include "vcc.h"
 
-void perform_tx();
+void perform_tx(int8_t from);
+static int8_t day_first(uint8_t days);
+static void clear_events();
+static uint8_t serial_command();
+static uint8_t serial_measure();
+static uint8_t data_present();
+
+static uint8_t prompt;	// 1 = send '>' before waiting for the next command line
+static uint8_t measuring;	// ticks of the measurement of command t, 0 = none
+
+/**
+ * eeprom address of the event at index (0 = oldest) of the event ring
+ */
+static event_t *event_at(uint8_t index)
+{
+	index += globals.params.head;
+	return &eedata.events[index < MAX_EVENTS ? index : index - MAX_EVENTS];
+}
 
 /**
  * data transfer mode
- * - show "no d" blinking if no data
+ * - show "no d" blinking if nothing to export (data_present())
  *   -> KEY_SET leaves
  * - show "rEt " blinking if data present
- * - KEY_UP/KEY_DOWN -> toggle display "SEnd" / "rEt  " blinking
- * - KEY_SET @"SEnd" -> start transfer
+ * - KEY_UP/KEY_DOWN -> cycle display "rEt " / "SEnd" / "nEu " / "LSt1" ...
+ *   "LSt<DAY_INDEX>" not blinking
+ * - KEY_SET @"SEnd" -> start transfer of all events
+ * - KEY_SET @"nEu " -> start transfer of events not exported yet
+ * - KEY_SET @"LStn" -> start transfer of events of the last n days (today
+ *   is day 1), the export marker is kept
  * - KEY_SET @"rEt " -> leave
- * - show "CLr " blinking after transfer
+ * - show "rEt " blinking after transfer, export marker is set behind last event
  * - KEY_UP/KEY_DOWN -> toggle display "rEt  " / "CLr " no blinking 
  * - KEY_SET @"CLr " -> clear data, leave
  * - KEY_SET @"rEt " -> leave
+ *
+ * while waiting for keys the serial command interface is served
  */
+#define DATA_RET	0
+#define DATA_SEND	1
+#define DATA_NEW	2
+#define DATA_DAYS	3	// DATA_DAYS + n - 1 = last n days
+#define DATA_LAST	(DATA_DAYS + DAY_INDEX - 1)
+
+static void data_show(uint8_t data_mode)
+{
+	if (data_mode >= DATA_DAYS) {
+		TM1637_display_msg_P(MSG_LSt);
+		TM1637_display_digit(3, data_mode - DATA_DAYS + 1);
+	} else {
+		TM1637_display_msg_P(data_mode == DATA_SEND ? MSG_SEnd : (data_mode == DATA_NEW ? MSG_nEu : MSG_rEt));
+	}
+}
+
 uint8_t	mode_data(uint8_t key)
 {
 	static uint8_t data_mode = 0;
@@ -40,23 +84,28 @@ uint8_t	mode_data(uint8_t key)
 	switch (globals.submode) {
 		case 0:
 			globals.dsp_stat = DSP_BLINK;
-			TM1637_display_msg(globals.params.write == 0 ? MSG_no_d : MSG_rEt);
-			data_mode = 0;
+			TM1637_display_msg_P(data_present() ? MSG_rEt : MSG_no_d);
+			data_mode = DATA_RET;
+			prompt = 1;		// host may wait for '>' of a previous visit
+			measuring = 0;	// t of a previous visit left by KEY_SET_L
 			globals.submode = 1;
 			break;
 
 		case 1:
-			if (globals.params.write == 0) {
+			if (serial_command()) {
+				break;
+			}
+			if (!data_present()) {
 				if (key == KEY_SET) {
 					globals.submode = SUBMODE_EXIT;
 				}
 			} else {
 				if (key == KEY_UP || key == KEY_DOWN) {
 					globals.dsp_stat = DSP_ON;
-					data_mode ^= 1;
-					TM1637_display_msg(data_mode ? MSG_SEnd : MSG_rEt);
+					data_mode += key == KEY_UP ? (data_mode == DATA_LAST ? -DATA_LAST : 1) : (data_mode == DATA_RET ? DATA_LAST : -1);
+					data_show(data_mode);
 				} else if (key == KEY_SET) {
-					globals.submode = data_mode ? 2 : SUBMODE_EXIT;
+					globals.submode = data_mode != DATA_RET ? 2 : SUBMODE_EXIT;
 				}
 			}
 			break;
@@ -68,28 +117,34 @@ uint8_t	mode_data(uint8_t key)
 			break;
 
 		case 3: // transfer
-			perform_tx();
+			if (data_mode >= DATA_DAYS) {
+				perform_tx(day_first(data_mode - DATA_DAYS + 1));
+			} else {
+				perform_tx(data_mode == DATA_NEW ? globals.params.exported : 0);
+				globals.params.exported = globals.params.write;
+				ee_defer(EE_PARAMS);
+			}
 			data_mode = 0;
 			globals.dsp_stat = DSP_BLINK;
-			TM1637_display_msg(MSG_rEt);
+			TM1637_display_msg_P(MSG_rEt);
 			globals.submode = 4;
 			break;
 
 		case 4:
+			if (serial_command()) {
+				break;
+			}
 			if (key == KEY_UP || key == KEY_DOWN) {
 				globals.dsp_stat = DSP_ON;
 				data_mode ^= 1;
-				TM1637_display_msg(data_mode ? MSG_CLr: MSG_rEt);
+				TM1637_display_msg_P(data_mode ? MSG_CLr: MSG_rEt);
 			} else if (key == KEY_SET) {
 				globals.submode = data_mode ? 5 : SUBMODE_EXIT;
 			}
 			break;
 
 		case 5:
-			globals.params.write = 0;
-			globals.params.minmax.low = BINTEMP(60.0);
-			globals.params.minmax.high = BINTEMP(-55.0);
-			eeprom_update_block(&globals.params, &eedata.params, sizeof(params_t));
+			clear_events();
 			// no break;
 		case SUBMODE_EXIT:
 			globals.mode = MODE_WATCH;
@@ -101,73 +156,817 @@ uint8_t	mode_data(uint8_t key)
 }
 
 /**
- * transmit key / value pair
+ * transmit key (PSTR()) / value pair
  */
-void uart_tx_value(char *key, char *value)
+void uart_tx_value_P(const char *key, char *value)
 {
-	uart_tx_string("  \"");
-	uart_tx_string(key);
-	uart_tx_string("\": ");
+	uart_tx_string_P(PSTR("  \""));
+	uart_tx_string_P(key);
+	uart_tx_string_P(PSTR("\": "));
 	uart_tx_string(value);
-	uart_tx_string(",\n");
+	uart_tx_string_P(PSTR(",\n"));
 }
 
 /**
- * perform transfer (JSON format)
+ * convert unsigned number to ascii
+ */
+static char *ulong_2_string(uint32_t num)
+{
+	static char buffer[11];
+	register char *bp = buffer + sizeof(buffer) - 1;
+
+	*bp = 0;
+	do {
+		*--bp = (char)(num % 10) + '0';
+		num /= 10;
+	} while (num != 0);
+	return bp;
+}
+
+/**
+ * perform transfer (JSON format) of events starting at index from
  *
  * {
+ *   "id": 7,						unit id
  *   "tH": 5.5,						temperature threshold high
  *   "tL": 2.0,						temperature threshold low
  *   "mH": 2.0,						temperature max
  *   "mL": 2.0,						temperature min
+ *   "ld": 10,						predictive irrigation start lead time [min]
+ *   "in": 10,						measurement interval min [s]
+ *   "ix": 120,						measurement interval max [s] (max CACHE_MAX_AGE)
+ *   "sp": 1,						sensor parasite powered (0 = external supply)
+ *   "sf": 16,						sensor family code (16 = DS18S20, 40 = DS18B20)
+ *   "vc": 4960,					supply voltage last reading [mV] (0 = none)
+ *   "vm": 4820,					supply voltage min [mV]
+ *   "vl": 2900,					supply voltage safe state threshold [mV]
+ *   "st": 0,						telemetry record after each measurement (1 = on)
+ *   "xp": 0,						sensor fault policy (0 = keep, 1 = irrigate, 2 = stop)
+ *   "xr": 14,						failed sensor readings
+ *   "xf": 1,						sensor faults (fail-safe entered)
+ *   "xv": 3,						recoveries after failed readings
+ *   "iv": 0,						runtime check violations INV_xxx (bits)
+ *   "wt": 12,						worst-case tick ISR time [ms]
+ *   "wm": 3,						mode of the worst-case tick
+ *   "wo": 0,						tick ISR overruns
+ *   "rs": 8,						reset cause (MCUSR) of the current run
+ *   "rw": 1,						watchdog resets
+ *   "rb": 0,						brown-out resets
+ *   "ws": 1,						irrigation resumed after the last reset (warm restart)
+ *   "pr": [60,0, 60,30, ...],		pulse profile on/off [s] per irrigation mode
+ *   "fc": 12,						event writes the unfiltered temperature would cause
+ *   "fw": 3,						event writes of the filtered temperature
+ *   "fs": 9,						event writes saved by filter (fc - fw, negative
+ *									if the filter caused more writes)
+ *   "el": 0,						events dropped on full event memory before
+ *									export or summary (saturating at 255)
+ *   "nt": "2021-03-27 02:10",		start of last irrigation night
+ *   "rt": 86400,					relay on time total [s]
+ *   "rn": 3600,					relay on time last irrigation night [s]
+ *   "ct": 420,						relay actuations total
+ *   "cn": 35,						relay actuations last irrigation night
+ *   "hb": -3.0,					histogram first bin temperature
+ *   "hi": [0, 12, 310, ...],		minutes per 0.5[] bin, first / last bin
+ *									include all temperatures below / above
+ *   "su": [{						frost episode summaries (oldest first)
+ *     "ts": "2021-03-27 01:10",	  episode start
+ *     "te": "2021-03-27 08:30",	  episode end
+ *     "tm": -1.5,					  min temperature
+ *     "it": 240,					  irrigation (relay on) time [min]
+ *     "im": 5						  peak irrigation mode
+ *   },{
+ *     ...
+ *   }],
+ *   "rc": 8,						reset cause (MCUSR) of the frozen trace (if any)
+ *   "tr": [[4711, 3, 1, 255, 1.5, 2], ...],
+ *									state transitions before that reset, oldest
+ *									first: timestamp [s] low word, mode, submode
+ *									(table modes: 128 + state of mode_table.c),
+ *									key, temperature, irrigation mode
  *   "ev": [{						events
 	   "n": 1,						  event number
  *     "ts": "2021-03-27 12:42",	  timestamp
  *     "tm": 1.5,					  temperature
- *     "im": 1						  irrigation mode
+ *     "pc": "2021-03-27 12:52",	  predicted low temperature crossing (if any)
+ *     "im": 1						  irrigation mode, or for sensor fault events
+ *     "fe": 1						  fault cause (1 = no reset, 2 = no data,
+ *									  3 = out of range), temperature "tm" is
+ *									  the last valid one
  *   },{
  *     ...
  *   }]
  * }
  */
-void perform_tx()
+void perform_tx(int8_t from)
 {
-	register uint8_t read = 0;
+	register uint8_t read, first;
 	event_t ev;
 
 	DS18x20_PWROFF();
 	DS18x20_OUTPUT();
-	uart_tx_string("\n{\n");
-	uart_tx_value("tH", (char *)temp_2_value(globals.params.temperatures.high, 1));
-	uart_tx_value("tL", (char *)temp_2_value(globals.params.temperatures.low, 1));
-	uart_tx_value("mH", (char *)temp_2_value(globals.params.minmax.high, 1));
-	uart_tx_value("mL", (char *)temp_2_value(globals.params.minmax.low, 1));
-	uart_tx_string("  \"ev\": [{");
-	while (1) {
-		eeprom_read_block(&ev, &eedata.events[read], sizeof(event_t));
-		uart_tx_string("\n  ");
-		uart_tx_value("n", (char *)num_2_value(read, 0, 1, 0));
-		uart_tx_string("  ");
-		uart_tx_value("ts", timestamp_2_string(ev.timestamp));
-		uart_tx_string("  ");
-		uart_tx_value("tm", (char *)temp_2_value(ev.temp, 1));
-		uart_tx_string("    \"im\": ");
-		uart_tx(ev.irri_mode + '0');
-		uart_tx_string("\n  }");
-		if (++read < globals.params.write) {
-			uart_tx_string(",{");
-		} else {
-			break;
-		}
-	}
-	uart_tx_string("]\n}\n");
+	uart_tx_string_P(PSTR("\n{\n"));
+	uart_tx_value_P(PSTR("id"), ulong_2_string(globals.params.unit));
+	uart_tx_value_P(PSTR("tH"), (char *)temp_2_value(globals.params.temperatures.high, 1));
+	uart_tx_value_P(PSTR("tL"), (char *)temp_2_value(globals.params.temperatures.low, 1));
+	uart_tx_value_P(PSTR("mH"), (char *)temp_2_value(globals.params.minmax.high, 1));
+	uart_tx_value_P(PSTR("mL"), (char *)temp_2_value(globals.params.minmax.low, 1));
+	uart_tx_value_P(PSTR("ld"), ulong_2_string(globals.params.lead));
+	uart_tx_value_P(PSTR("in"), ulong_2_string(globals.params.interval_min));
+	uart_tx_value_P(PSTR("ix"), ulong_2_string(globals.params.interval_max));
+	uart_tx_value_P(PSTR("sp"), ulong_2_string(DS18x20_parasite));
+	uart_tx_value_P(PSTR("sf"), ulong_2_string(DS18x20_family));
+	uart_tx_value_P(PSTR("vc"), ulong_2_string((uint16_t)globals.vcc * VCC_UNIT));
+	uart_tx_value_P(PSTR("vm"), ulong_2_string((uint16_t)globals.params.vcc_min * VCC_UNIT));
+	uart_tx_value_P(PSTR("vl"), ulong_2_string((uint16_t)globals.params.vcc_low * VCC_UNIT));
+	uart_tx_value_P(PSTR("st"), ulong_2_string(globals.params.telemetry));
+	uart_tx_value_P(PSTR("xp"), ulong_2_string(globals.params.fail_policy));
+	uart_tx_value_P(PSTR("xr"), ulong_2_string(globals.faults.retries));
+	uart_tx_value_P(PSTR("xf"), ulong_2_string(globals.faults.faults));
+	uart_tx_value_P(PSTR("xv"), ulong_2_string(globals.faults.recoveries));
+#if CHECK_INVARIANTS
+	uart_tx_value_P(PSTR("iv"), ulong_2_string(globals.check.violations));
+	uart_tx_value_P(PSTR("wt"), ulong_2_string(globals.check.isr_max * 1024UL / 1000));
+	uart_tx_value_P(PSTR("wm"), ulong_2_string(globals.check.isr_mode));
+	uart_tx_value_P(PSTR("wo"), ulong_2_string(globals.check.overruns));
+#endif
+	uart_tx_value_P(PSTR("rs"), ulong_2_string(globals.reset));
+	uart_tx_value_P(PSTR("rw"), ulong_2_string(globals.params.wdt_resets));
+	uart_tx_value_P(PSTR("rb"), ulong_2_string(globals.params.bor_resets));
+	uart_tx_value_P(PSTR("ws"), ulong_2_string(globals.warm));
+	wdt_reset();	// the export takes several ticks
+	uart_tx_string_P(PSTR("  \"pr\": ["));
+	for (read = 0; read < PROFILE_BANDS; read++) {
+		profile_t profile;
+
+		eeprom_read_block(&profile, &eedata.profile[read], sizeof(profile_t));
+		if (read > 0) {
+			uart_tx_string_P(PSTR(", "));
+		}
+		uart_tx_string(ulong_2_string(profile.on * 10UL));
+		uart_tx(',');
+		uart_tx_string(ulong_2_string(profile.off * 10UL));
+	}
+	uart_tx_string_P(PSTR("],\n"));
+	uart_tx_value_P(PSTR("fc"), ulong_2_string(irri.flt_raw));
+	uart_tx_value_P(PSTR("fw"), ulong_2_string(irri.flt_writes));
+	if (irri.flt_raw >= irri.flt_writes) {
+		uart_tx_value_P(PSTR("fs"), ulong_2_string(irri.flt_raw - irri.flt_writes));
+	} else {
+		register char *bp = ulong_2_string(irri.flt_writes - irri.flt_raw);
+
+		*--bp = '-';
+		uart_tx_value_P(PSTR("fs"), bp);
+	}
+	uart_tx_value_P(PSTR("el"), ulong_2_string(globals.params.lost));
+	uart_tx_value_P(PSTR("nt"), timestamp_2_string(globals.relay.night));
+	uart_tx_value_P(PSTR("rt"), ulong_2_string(globals.relay.on_total));
+	uart_tx_value_P(PSTR("rn"), ulong_2_string(globals.relay.on_night));
+	uart_tx_value_P(PSTR("ct"), ulong_2_string(globals.relay.sw_total));
+	uart_tx_value_P(PSTR("cn"), ulong_2_string(globals.relay.sw_night));
+	uart_tx_value_P(PSTR("hb"), (char *)temp_2_value(globals.params.histo_base, 1));
+	uart_tx_string_P(PSTR("  \"hi\": ["));
+	for (read = 0; read < HISTO_BINS; read++) {
+		if (read > 0) {
+			uart_tx_string_P(PSTR(", "));
+		}
+		uart_tx_string(ulong_2_string(eeprom_read_word(&eedata.histogram[read])));
+	}
+	uart_tx_string_P(PSTR("],\n"));
+	uart_tx_string_P(PSTR("  \"su\": ["));
+	first = globals.params.summaries < MAX_SUMMARIES ? 0 : globals.params.summaries - MAX_SUMMARIES;
+	for (read = first; read < globals.params.summaries; read++) {
+		summary_t su;
+
+		wdt_reset();
+		eeprom_read_block(&su, &eedata.summaries[read % MAX_SUMMARIES], sizeof(summary_t));
+		uart_tx_string_P(read == first ? PSTR("{\n  ") : PSTR(",{\n  "));
+		uart_tx_value_P(PSTR("ts"), timestamp_2_string(su.start));
+		uart_tx_string_P(PSTR("  "));
+		uart_tx_value_P(PSTR("te"), timestamp_2_string(su.start + su.duration * 60UL));
+		uart_tx_string_P(PSTR("  "));
+		uart_tx_value_P(PSTR("tm"), (char *)temp_2_value(su.temp, 1));
+		uart_tx_string_P(PSTR("  "));
+		uart_tx_value_P(PSTR("it"), ulong_2_string(su.irrigation));
+		uart_tx_string_P(PSTR("    \"im\": "));
+		uart_tx(su.irri_mode + '0');
+		uart_tx_string_P(PSTR("\n  }"));
+	}
+	uart_tx_string_P(PSTR("],\n"));
+#if TRACE_DEPTH > 0
+	first = eeprom_read_byte(&eedata.trace.cause);
+	if (first != EEUNSET) {
+		const char *sep = PSTR("[");
+
+		uart_tx_value_P(PSTR("rc"), ulong_2_string(first));
+		uart_tx_string_P(PSTR("  \"tr\": ["));
+		for (read = 0; read < TRACE_DEPTH; read++) {
+			trace_t tr;
+
+			eeprom_read_block(&tr, &eedata.trace.ring[read], sizeof(trace_t));
+			if (tr.mode != 0xFF) {
+				uart_tx_string_P(sep);
+				sep = PSTR(",[");
+				uart_tx_string(ulong_2_string(tr.tick));
+				uart_tx(',');
+				uart_tx_string(ulong_2_string(tr.mode));
+				uart_tx(',');
+				uart_tx_string(ulong_2_string(tr.submode));
+				uart_tx(',');
+				uart_tx_string(ulong_2_string(tr.key));
+				uart_tx(',');
+				uart_tx_string((char *)temp_2_value(tr.temp, 1));
+				uart_tx(',');
+				uart_tx_string(ulong_2_string(tr.irri_mode));
+				uart_tx(']');
+			}
+		}
+		uart_tx_string_P(PSTR("],\n"));
+	}
+#endif
+	uart_tx_string_P(PSTR("  \"ev\": ["));
+	for (read = from; read < globals.params.write; read++) {
+		wdt_reset();
+		eeprom_read_block(&ev, event_at(read), sizeof(event_t));
+		uart_tx_string_P(read == from ? PSTR("{\n  ") : PSTR(",{\n  "));
+		uart_tx_value_P(PSTR("n"), (char *)num_2_value(read, 0, 1, 0));
+		uart_tx_string_P(PSTR("  "));
+		uart_tx_value_P(PSTR("ts"), timestamp_2_string(ev.timestamp));
+		uart_tx_string_P(PSTR("  "));
+		uart_tx_value_P(PSTR("tm"), (char *)temp_2_value(ev.temp, 1));
+		if (ev.eta > 0) {
+			uart_tx_string_P(PSTR("  "));
+			uart_tx_value_P(PSTR("pc"), timestamp_2_string(ev.timestamp + (uint32_t)ev.eta * 60));
+		}
+		uart_tx_string_P(ev.irri_mode & EVENT_FAULT ? PSTR("    \"fe\": ") : PSTR("    \"im\": "));
+		uart_tx((ev.irri_mode & ~EVENT_FAULT) + '0');
+		uart_tx_string_P(PSTR("\n  }"));
+	}
+	uart_tx_string_P(PSTR("]\n}\n"));
 	DS18x20_INPUT();
 }
 
+/**
+ * first event of the last days (today is day 1)
+ *
+ * the day index is searched from the newest day; if all indexed days are
+ * in range, older events may belong to days dropped from the index, they
+ * are searched by their timestamps
+ */
+static int8_t day_first(uint8_t days)
+{
+	register const daymark_t *index = globals.days;
+	uint16_t since = (uint16_t)(globals.params.timestamp / DAY_SECONDS) - (days - 1);
+	uint32_t timestamp;
+	register int8_t from = globals.params.write;
+	register int8_t i;
+
+	for (i = DAY_INDEX - 1; i >= 0; i--) {
+		if (index[i].day == DAY_UNSET) {
+			continue;
+		}
+		if (index[i].day < since) {
+			break;
+		}
+		from = index[i].first;
+	}
+	if (i < 0) {
+		for (i = 0; i < from; i++) {
+			eeprom_read_block(&timestamp, &event_at(i)->timestamp, sizeof(uint32_t));
+			if (timestamp / DAY_SECONDS >= since) {
+				break;
+			}
+		}
+		from = i;
+	}
+	return from;
+}
+
+/**
+ * transmit byte as two hex digits, returns updated crc
+ */
+static uint8_t tx_hex(uint8_t byte, uint8_t crc)
+{
+	register uint8_t digit = byte >> 4;
+
+	uart_tx(digit < 10 ? digit + '0' : digit - 10 + 'A');
+	digit = byte & 0x0F;
+	uart_tx(digit < 10 ? digit + '0' : digit - 10 + 'A');
+	return _crc8_ccitt_update(crc, byte);
+}
+
+/**
+ * transmit telemetry record (watch mode, after a measurement)
+ *
+ *   ':' tttttttt TT MM FF CC '\n'
+ *
+ * tttttttt timestamp [s], TT last valid binary temperature, MM irrigation
+ * mode, FF flags TLM_xxx, CC CRC-8 (_crc8_ccitt_update) of the 7 bytes,
+ * all hex, most significant first (~9.5[ms] at 19200 Baud)
+ *
+ * hex digits and framing keep the line low for at most 5 bit times
+ * (260[us]), so the sensor on the shared line never sees a reset pulse
+ */
+void telemetry(uint8_t flags)
+{
+	register uint8_t crc = 0;
+	register int8_t shift;
+
+	DS18x20_PWROFF();
+	uart_tx(':');
+	for (shift = 24; shift >= 0; shift -= 8) {
+		crc = tx_hex((uint8_t)(globals.params.timestamp >> shift), crc);
+	}
+	crc = tx_hex((uint8_t)globals.tcache.value, crc);
+	crc = tx_hex(irri.irri_mode, crc);
+	crc = tx_hex(flags, crc);
+	tx_hex(crc, 0);
+	uart_tx('\n');
+}
+
+/**
+ * clear event data, min/max temperatures and min supply voltage
+ */
+static void clear_events()
+{
+	if (globals.vcc_safe) {
+		return;		// eeprom keeps the data in the safe state
+	}
+	globals.params.write = 0;
+	globals.params.exported = 0;
+	globals.params.head = 0;
+	globals.params.lost = 0;
+	globals.params.summaries = 0;
+	globals.episode.start = 0;
+	histogram_clear();
+	globals.params.minmax.low = BINTEMP(60.0);
+	globals.params.minmax.high = BINTEMP(-55.0);
+	globals.params.vcc_min = EEUNSET;
+	ee_defer(EE_PARAMS);
+	day_index_clear();
+}
+
+/**
+ * parse unsigned decimal number, returns pointer behind number or NULL
+ */
+static char *parse_num(char *s, uint32_t *num)
+{
+	if (*s < '0' || *s > '9') {
+		return NULL;
+	}
+	*num = 0;
+	while (*s >= '0' && *s <= '9') {
+		*num = *num * 10 + (*s++ - '0');
+	}
+	return s;
+}
+
+/**
+ * parse temperature [-]d[.d] to binary temperature, returns pointer behind
+ * temperature or NULL
+ */
+static char *parse_temp(char *s, int8_t *temp)
+{
+	register uint8_t neg = *s == '-';
+	uint32_t num;
+	
+	if ((s = parse_num(s + neg, &num)) == NULL || num > 60) {
+		return NULL;
+	}
+	*temp = BINTEMP((int8_t)num);
+	if (*s == '.') {
+		if (s[1] < '0' || s[1] > '9') {
+			return NULL;
+		}
+		*temp += s[1] >= '5';
+		s += 2;
+	}
+	if (neg) {
+		*temp = -*temp;
+	}
+	return s;
+}
+
+/**
+ * serial command interface
+ *
+ * host commands are lines terminated by '\n' (19200 Baud, 8N1). The device
+ * sends '>' when it is ready to receive the next command line and answers
+ * each command with "ok" or "er" (after the command output, if any).
+ *
+ *   t                  -> current temperature "tm", cached reading not older
+ *                         than CACHE_FRESH [s] with its age "ta" [s],
+ *                         else new measurement (~1[s], spread over the
+ *                         ticks like in watch mode)
+ *   p<tH>,<tL>,<bri>   -> set threshold temperatures (0.5 steps) and brightness
+ *   c<timestamp>       -> set clock, [s] since 1970-01-01 00:00:00
+ *   l<lead>            -> set predictive irrigation start lead time [min], 0 = off
+ *   i<min>,<max>       -> set measurement interval bounds [s] (2...CACHE_MAX_AGE)
+ *   r<mode>,<on>,<off> -> set pulse profile of irrigation mode 1...PROFILE_BANDS,
+ *                         on / off phase [s] (10[s] steps), off = 0 -> constant on
+ *   o                  -> calibrate oscillator, host sends 'U' for ~100[ms]
+ *                         after the command line, answers calibration "oc",
+ *                         "er" if more than OSCCAL_RANGE off the factory value
+ *   d                  -> transfer all events (like "SEnd")
+ *   d<days>            -> transfer events of the last days (like "LStn",
+ *                         1...255)
+ *   n                  -> transfer new events (like "nEu ")
+ *   x                  -> clear events (like "CLr ")
+ *   h<temp>            -> set histogram first bin temperature (0.5 steps),
+ *                         clears histogram
+ *   v<mV>              -> set supply voltage safe state threshold [mV],
+ *                         0 = off
+ *   f<policy>          -> set relay policy on sensor fault, 0 = keep last
+ *                         irrigation mode, 1 = irrigate, 2 = stop
+ *   s<0|1>             -> telemetry record after each measurement off / on
+ *   u<id>              -> set unit id of the export (0...255)
+ *   q                  -> leave data transfer mode
+ *
+ * in the supply voltage safe state (no eeprom writes) only t, d, n, v and
+ * q are accepted, v changes the threshold in RAM to leave a misconfigured
+ * safe state; the others answer "er"
+ *
+ * waits up to ~70[ms] for a command so the mode function returns within
+ * the 100[ms] period, returns 1 if a command was executed
+ */
+static uint8_t serial_command()
+{
+	static char line[20];
+	register uint8_t ok = 0;
+	register char *lp = line + 1;
+	uint32_t num, max, on_off;
+	int16_t temp;
+	int8_t high, low;
+
+	if (measuring) {
+		return serial_measure();
+	}
+	DS18x20_PWROFF();
+	if (prompt) {
+		uart_tx('>');
+		prompt = 0;
+	}
+	if (uart_rx_line(line, sizeof(line), UART_RX_MS(70)) == 0) {
+		return 0;
+	}
+	if (   globals.vcc_safe
+		&& line[0] != 't' && line[0] != 'd' && line[0] != 'n' && line[0] != 'v' && line[0] != 'q') {
+		line[0] = 0;	// settings are not saved in the safe state -> "er"
+	}
+	switch (line[0]) {
+		case 't':
+			if ((num = tcache_age()) <= CACHE_FRESH) {
+				uart_tx_value_P(PSTR("tm"), (char *)temp_2_value(globals.tcache.value, 1));
+				uart_tx_value_P(PSTR("ta"), (char *)num_2_value((int16_t)num, 0, 1, 0));
+				ok = 1;
+				break;
+			}
+			DS18x20_PWRON();	// give sensor 200[ms] power
+			measuring = 1;
+			return 1;			// answered by serial_measure()
+
+		case 'p':
+			if (   (lp = parse_temp(lp, &high)) != NULL && *lp++ == ','
+				&& (lp = parse_temp(lp, &low)) != NULL && *lp++ == ','
+				&& (lp = parse_num(lp, &num)) != NULL && *lp == 0
+				&& low >= 0 && high <= BINTEMP(10) && low <= high && num <= MAX_BRIGHTNESS) {
+				globals.params.temperatures.high = high;
+				globals.params.temperatures.low = low;
+				globals.params.brightness = (uint8_t)num;
+				TM1637_set_brightness((uint8_t)num);
+				ee_defer(EE_PARAMS);
+				ok = 1;
+			}
+			break;
+
+		case 'c':
+			if ((lp = parse_num(lp, &num)) != NULL && *lp == 0 && num >= DT_2021_4_5_12_0_0) {
+				globals.params.timestamp = num;
+				ee_defer(EE_PARAMS);
+				ok = 1;
+			}
+			break;
+
+		case 'l':
+			if ((lp = parse_num(lp, &num)) != NULL && *lp == 0 && num <= 0xFF) {
+				globals.params.lead = (uint8_t)num;
+				ee_defer(EE_PARAMS);
+				ok = 1;
+			}
+			break;
+
+		case 'i':
+			if (   (lp = parse_num(lp, &num)) != NULL && *lp++ == ','
+				&& (lp = parse_num(lp, &max)) != NULL && *lp == 0
+				&& num >= 2 && num <= max && max <= CACHE_MAX_AGE) {
+				globals.params.interval_min = (uint8_t)num;
+				globals.params.interval_max = (uint8_t)max;
+				ee_defer(EE_PARAMS);
+				ok = 1;
+			}
+			break;
+
+		case 'r':
+			if (   (lp = parse_num(lp, &num)) != NULL && *lp++ == ','
+				&& (lp = parse_num(lp, &max)) != NULL && *lp++ == ','
+				&& (lp = parse_num(lp, &on_off)) != NULL && *lp == 0
+				&& num >= 1 && num <= PROFILE_BANDS
+				&& max >= 10 && max < 10 * 0xFF && on_off < 10 * 0xFF) {
+				profile_t profile = { (uint8_t)(max / 10), (uint8_t)(on_off / 10) };
+
+				ee_update(&profile, &eedata.profile[num - 1], sizeof(profile_t));
+				profile_load();
+				ok = 1;
+			}
+			break;
+
+		case 'o':
+			num = OSCCAL;
+			if ((temp = uart_calibrate()) != UART_RX_NONE) {
+				if (!OSCCAL_VALID(temp)) {
+					OSCCAL = (uint8_t)num;	// implausible, keep the clock
+					break;
+				}
+				globals.params.osccal = (uint8_t)temp;
+				ee_defer(EE_PARAMS);
+				uart_tx_value_P(PSTR("oc"), (char *)num_2_value(temp, 0, 1, 0));
+				ok = 1;
+			}
+			break;
+
+		case 'd':
+			if (line[1] != 0) {
+				if ((lp = parse_num(lp, &num)) != NULL && *lp == 0 && num >= 1 && num <= 0xFF) {
+					perform_tx(day_first((uint8_t)num));
+					ok = 1;
+				}
+				break;
+			}
+			// no break;
+		case 'n':
+			perform_tx(line[0] == 'n' ? globals.params.exported : 0);
+			globals.params.exported = globals.params.write;
+			ee_defer(EE_PARAMS);
+			ok = 1;
+			break;
+
+		case 'x':
+			clear_events();
+			ok = 1;
+			break;
+
+		case 'h':
+			if (   (lp = parse_temp(lp, &low)) != NULL && *lp == 0
+				&& low >= BINTEMP(-20) && low <= BINTEMP(30)) {
+				globals.params.histo_base = low;
+				ee_defer(EE_PARAMS);
+				histogram_clear();
+				ok = 1;
+			}
+			break;
+
+		case 'v':
+			if ((lp = parse_num(lp, &num)) != NULL && *lp == 0 && num <= 0xFFUL * VCC_UNIT) {
+				globals.params.vcc_low = (uint8_t)(num / VCC_UNIT);
+				ee_defer(EE_PARAMS);
+				ok = 1;
+			}
+			break;
+
+		case 's':
+			if ((lp = parse_num(lp, &num)) != NULL && *lp == 0 && num <= 1) {
+				globals.params.telemetry = (uint8_t)num;
+				ee_defer(EE_PARAMS);
+				ok = 1;
+			}
+			break;
+
+		case 'u':
+			if ((lp = parse_num(lp, &num)) != NULL && *lp == 0 && num <= 0xFF) {
+				globals.params.unit = (uint8_t)num;
+				ee_defer(EE_PARAMS);
+				ok = 1;
+			}
+			break;
+
+		case 'f':
+			if ((lp = parse_num(lp, &num)) != NULL && *lp == 0 && num <= FAIL_STOP) {
+				globals.params.fail_policy = (uint8_t)num;
+				ee_defer(EE_PARAMS);
+				ok = 1;
+			}
+			break;
+
+		case 'q':
+			globals.submode = SUBMODE_EXIT;
+			ok = 1;
+			break;
+	}
+	uart_tx_string_P(ok ? PSTR("ok\n") : PSTR("er\n"));
+	prompt = 1;
+	return 1;
+}
+
+/**
+ * measurement of command t, one step per tick: 2 ticks sensor power,
+ * start of conversion, conversion time (externally powered: until
+ * complete), reading and answer
+ *
+ * returns 1 (command in progress or answered)
+ */
+static uint8_t serial_measure()
+{
+	register int16_t temp;
+	register uint8_t ok = 0;
+
+	if (++measuring < 3) {
+		return 1;
+	}
+	if (measuring == 3) {
+		DS18x20_PWROFF();
+		if (DS18x20_startcv() != DS18x20_NO_RESET) {
+			return 1;
+		}
+	} else if (measuring < CONVERSION_TIME + 3 && (DS18x20_parasite || !DS18x20_readbit())) {
+		return 1;
+	} else if ((temp = DS18x20_readtemp()) < DS18x20_NO_VALUE) {
+		if (temp >= BINTEMP(-20.0) && temp < BINTEMP(40.0)) {
+			globals.tcache.value = (int8_t)temp;
+			globals.tcache.stamp = globals.params.timestamp;
+			globals.tcache.valid = 1;
+		}
+		uart_tx_value_P(PSTR("tm"), (char *)temp_2_value(temp, 1));
+		ok = 1;
+	}
+	measuring = 0;
+	uart_tx_string_P(ok ? PSTR("ok\n") : PSTR("er\n"));
+	prompt = 1;
+	return 1;
+}
+
+/**
+ * clear day index
+ */
+void day_index_clear()
+{
+	memset(globals.days, 0xFF, sizeof(globals.days));
+	ee_defer(EE_DAYS);
+}
+
+/**
+ * enter event at index first into the day index, if it is the first event
+ * of its day (the oldest day is dropped on a full index)
+ */
+static void day_index_add(uint32_t timestamp, uint8_t first)
+{
+	register daymark_t *index = globals.days;
+	register uint16_t day = (uint16_t)(timestamp / DAY_SECONDS);
+	register uint8_t used;
+
+	for (used = 0; used < DAY_INDEX && index[used].day != DAY_UNSET; used++) {
+	}
+	if (used > 0 && index[used - 1].day == day) {
+		return;
+	}
+	if (used == DAY_INDEX) {
+		memmove(index, index + 1, (DAY_INDEX - 1) * sizeof(daymark_t));
+		used--;
+	}
+	index[used].day = day;
+	index[used].first = first;
+	ee_defer(EE_DAYS);
+}
+
+/**
+ * drop count oldest events from the day index, days without events left
+ * are removed, event indexes move down
+ */
+static void day_index_drop(uint8_t count)
+{
+	register daymark_t *index = globals.days;
+	register uint8_t read, keep = 0;
+	register uint8_t next;
+
+	for (read = 0; read < DAY_INDEX && index[read].day != DAY_UNSET; read++) {
+		next = read < DAY_INDEX - 1 && index[read + 1].day != DAY_UNSET ? index[read + 1].first : globals.params.write;
+		if (next > count) {
+			index[keep].day = index[read].day;
+			index[keep].first = index[read].first > count ? index[read].first - count : 0;
+			keep++;
+		}
+	}
+	memset(index + keep, 0xFF, (DAY_INDEX - keep) * sizeof(daymark_t));
+	ee_defer(EE_DAYS);
+}
+
+/**
+ * drop count oldest events to make room, the ring head moves on (the
+ * events stay in place, params are written by the caller)
+ */
+static void drop_events(uint8_t count)
+{
+	day_index_drop(count);
+	globals.params.head += count;
+	if (globals.params.head >= MAX_EVENTS) {
+		globals.params.head -= MAX_EVENTS;
+	}
+	globals.params.write -= count;
+	globals.params.exported = globals.params.exported > count ? globals.params.exported - count : 0;
+}
+
+/**
+ * number of oldest events covered by the latest episode summary
+ */
+static uint8_t summarized_events()
+{
+	summary_t summary;
+	uint32_t end;
+	event_t event;
+	register uint8_t count = 0;
+
+	if (globals.params.summaries > 0) {
+		eeprom_read_block(&summary, &eedata.summaries[(globals.params.summaries - 1) % MAX_SUMMARIES], sizeof(summary_t));
+		end = summary.start + summary.duration * 60UL;
+		while (count < globals.params.write) {
+			eeprom_read_block(&event, event_at(count), sizeof(event_t));
+			if (event.timestamp > end) {
+				break;
+			}
+			count++;
+		}
+	}
+	return count;
+}
+
+/**
+ * write summary of the finished frost episode into the summary ring
+ */
+static void store_summary()
+{
+	summary_t summary;
+
+	summary.start = globals.episode.start;
+	summary.duration = (globals.params.timestamp - globals.episode.start) / 60;
+	summary.irrigation = (globals.relay.on_total - globals.episode.on_total) / 60;
+	summary.temp = globals.episode.temp;
+	summary.irri_mode = globals.episode.irri_mode;
+	ee_update(&summary, &eedata.summaries[globals.params.summaries % MAX_SUMMARIES], sizeof(summary_t));
+	if (++globals.params.summaries >= 2 * MAX_SUMMARIES) {
+		globals.params.summaries -= MAX_SUMMARIES;	// keep ring index, mark ring full
+	}
+	globals.episode.start = 0;
+}
+
+/**
+ * write event at write index
+ *
+ * on full event data exported events and events of summarized frost
+ * episodes are dropped; if there are none (a long frost episode, nothing
+ * exported) the oldest event is dropped and counted in params.lost, the
+ * running episode still gets its summary
+ */
+static void write_event(int8_t temp, uint8_t irri_mode, uint8_t eta)
+{
+	event_t event;
+
+	if (globals.params.write >= MAX_EVENTS) {
+		register uint8_t count = summarized_events();
+
+		if (count < globals.params.exported) {
+			count = globals.params.exported;
+		}
+		if (count == 0) {
+			count = 1;
+			if (globals.params.lost < 0xFF) {
+				globals.params.lost++;
+			}
+		}
+		drop_events(count);
+	}
+	event.temp = temp;
+	event.irri_mode = irri_mode;
+	event.eta = eta;
+	event.timestamp = globals.params.timestamp;
+	ee_update(&event, event_at(globals.params.write), sizeof(event_t));
+	day_index_add(event.timestamp, globals.params.write);
+	globals.params.write++;
+}
+
+/**
+ * store sensor fault event (irri_mode EVENT_FAULT | cause, last valid
+ * temperature), no episode accounting
+ */
+void store_fault(uint8_t cause)
+{
+	write_event(globals.tcache.value, EVENT_FAULT | cause, 0);
+	ee_defer(EE_PARAMS);
+}
+
 /**
  * store event
+ *
+ * on full event data the oldest events are dropped (write_event())
  */
-void store_event(int16_t temp, uint8_t irri_mode)
+void store_event(int16_t temp, uint8_t irri_mode, uint8_t eta)
 {
 	event_t event;
 	register uint8_t must_write = 0;
@@ -180,23 +979,131 @@ void store_event(int16_t temp, uint8_t irri_mode)
 		globals.params.minmax.high = temp;
 		wr_params = 1;
 	}
-	if (globals.params.write < MAX_EVENTS) {
-		if (globals.params.write > 0) {
-			eeprom_read_block(&event, &eedata.events[globals.params.write - 1], sizeof(event_t));
-			must_write = (temp < event.temp && irri_mode > 0) || (event.irri_mode != irri_mode && event.irri_mode > 0);
-		} else if (temp <= globals.params.temperatures.low || irri_mode != 0) {
-			must_write = 1;
+	if (globals.params.write > 0) {
+		eeprom_read_block(&event, event_at(globals.params.write - 1), sizeof(event_t));
+	} else {
+		event.irri_mode = IRRI_NO_EVENT;
+	}
+	must_write = irri_log(&irri.cfg, temp, irri_mode, event.temp, event.irri_mode);
+	if (must_write && globals.episode.start == 0) {
+		globals.episode.start = globals.params.timestamp;
+		globals.episode.on_total = globals.relay.on_total;
+		globals.episode.temp = temp;
+		globals.episode.irri_mode = irri_mode;
+	}
+	if (globals.episode.start != 0) {
+		if (temp < globals.episode.temp) {
+			globals.episode.temp = temp;
 		}
-		if (must_write) {
-			event.temp = temp;
-			event.irri_mode = irri_mode;
-			event.timestamp = globals.params.timestamp;
-			eeprom_update_block(&event, &eedata.events[globals.params.write], sizeof(event_t));
-			globals.params.write++;
-			wr_params = 1;
+		if (irri_mode > globals.episode.irri_mode) {
+			globals.episode.irri_mode = irri_mode;
 		}
 	}
+	if (must_write) {
+		irri.flt_writes++;
+		write_event(temp, irri_mode, eta);
+		wr_params = 1;
+	}
+	if (irri_mode == 0 && globals.episode.irri_mode > 0 && globals.episode.start != 0) {
+		store_summary();
+		wr_params = 1;
+	}
 	if (wr_params) {
-		eeprom_update_block(&globals.params, &eedata.params, sizeof(params_t));
+		ee_defer(EE_PARAMS);
+	}
+}
+
+static uint8_t histo_min[HISTO_BINS];	// histogram minutes not written yet
+static uint8_t histo_sec;				// seconds not counted yet
+static uint32_t histo_time;				// timestamp of last reading
+
+/**
+ * count time since last reading into the histogram bin of temp
+ */
+void histogram(int8_t temp)
+{
+	register int8_t bin = temp - globals.params.histo_base;
+	register uint16_t elapsed = globals.params.timestamp - histo_time;
+
+	if (histo_time == 0 || globals.params.timestamp - histo_time > HISTO_GAP) {
+		elapsed = 0;
+	}
+	if (bin < 0) {
+		bin = 0;
+	} else if (bin >= HISTO_BINS) {
+		bin = HISTO_BINS - 1;
+	}
+	elapsed += histo_sec;
+	while (elapsed >= 60) {
+		elapsed -= 60;
+		histo_min[bin]++;
+	}
+	histo_sec = elapsed;
+	if (histo_min[bin] >= HISTO_BATCH) {
+		histogram_flush();
+	}
+	histo_time = globals.params.timestamp;
+}
+
+/**
+ * add buffered minutes to eeprom histogram (saturating), the next reading
+ * starts a new period
+ */
+void histogram_flush()
+{
+	register uint8_t bin;
+	uint16_t minutes;
+
+	if (globals.vcc_safe) {
+		return;		// buffered until the safe state is left
+	}
+	for (bin = 0; bin < HISTO_BINS; bin++) {
+		if (histo_min[bin] > 0) {
+			minutes = eeprom_read_word(&eedata.histogram[bin]);
+			minutes = minutes > 0xFFFF - histo_min[bin] ? 0xFFFF : minutes + histo_min[bin];
+			ee_update(&minutes, &eedata.histogram[bin], sizeof(uint16_t));
+			histo_min[bin] = 0;
+		}
+	}
+	histo_time = 0;
+}
+
+/**
+ * clear eeprom histogram and buffer
+ */
+void histogram_clear()
+{
+	register uint8_t bin;
+	uint16_t minutes = 0;
+
+	for (bin = 0; bin < HISTO_BINS; bin++) {
+		ee_update(&minutes, &eedata.histogram[bin], sizeof(uint16_t));
+		histo_min[bin] = 0;
+	}
+	histo_sec = 0;
+	histo_time = 0;
+}
+
+/**
+ * any exportable data: events, episode summaries, relay accounting,
+ * histogram minutes or a frozen trace
+ */
+static uint8_t data_present()
+{
+	register uint8_t bin;
+
+	if (   globals.params.write > 0 || globals.params.summaries > 0
+		|| globals.relay.on_total > 0 || globals.relay.sw_total > 0) {
+		return 1;
+	}
+	for (bin = 0; bin < HISTO_BINS; bin++) {
+		if (histo_min[bin] > 0 || eeprom_read_word(&eedata.histogram[bin]) != 0) {
+			return 1;
+		}
 	}
+#if TRACE_DEPTH > 0
+	return eeprom_read_byte(&eedata.trace.cause) != EEUNSET;
+#else
+	return 0;
+#endif
 }
\ No newline at end of file
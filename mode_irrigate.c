@@ -17,8 +17,8 @@
  *
  * - show "oFF " not blinking
  * - KEY_UP/KEY_DOWN -> toggle display "on  " / "oFF "
- *   - @"oFF " -> IRRI_OFF(), blink off
- *   - @"on  " -> IRRI_ON(), blink on
+ *   - @"oFF " -> irrigation off, blink off
+ *   - @"on  " -> irrigation on, blink on
  * - KEY-SET_L -> set MODE_WATCH into globals.mode, leave
  * 
  */
@@ -26,12 +26,12 @@ uint8_t	mode_irrigate(uint8_t key)
 {
 	uint8_t	rc = MDS_RUN;
 	static uint8_t irri_mode = 0;
-	register uint8_t *msg;
+	register const uint8_t *msg;
 
 	switch (globals.submode) {
 		case 0:
 			globals.dsp_stat = DSP_ON;
-			TM1637_display_msg(MSG_oFF);
+			TM1637_display_msg_P(MSG_oFF);
 			irri_mode = 0;
 			globals.submode++;
 			break;
@@ -40,22 +40,63 @@ uint8_t	mode_irrigate(uint8_t key)
 				irri_mode ^= 1;
 				if (irri_mode) {
 					globals.dsp_stat = DSP_BLINK;
-					IRRI_ON();
+					irrigation(1);
 					msg = MSG_on;
 				}  else {
 					globals.dsp_stat = DSP_ON;
-					IRRI_OFF();
+					irrigation(0);
 					msg = MSG_oFF;
 				}
-				TM1637_display_msg((const uint8_t *)msg);
+				TM1637_display_msg_P(msg);
 			}
 			break;
 		case SUBMODE_EXIT:
 			globals.mode = MODE_WATCH;
 			globals.submode = 0;
-			IRRI_OFF();
+			irrigation(0);
+			irrigation_save();
 			rc = MDS_DONE;
 			break;
 	}
 	return rc;
 }
+
+/**
+ * switch irrigation relay on/off, count relay actuations
+ *
+ * relay on time is counted in ISR(TIM0_COMPA_vect)
+ */
+void irrigation(uint8_t on)
+{
+	if (!on) {
+		IRRI_OFF();
+	} else if (!IRRI_IS_ON()) {
+		IRRI_ON();
+		globals.relay.sw_total++;
+		globals.relay.sw_night++;
+	}
+}
+
+/**
+ * start of irrigation - starts new irrigation night accounting on the
+ * first irrigation start after NIGHT_START (noon), the accounting of the
+ * last night stays readable until then
+ */
+void irrigation_night()
+{
+	register uint32_t start = globals.params.timestamp - (globals.params.timestamp + DAY_SECONDS - NIGHT_START) % DAY_SECONDS;
+
+	if (globals.relay.night < start) {
+		globals.relay.night = globals.params.timestamp;
+		globals.relay.on_night = 0;
+		globals.relay.sw_night = 0;
+	}
+}
+
+/**
+ * save relay accounting into eeprom (end of irrigation)
+ */
+void irrigation_save()
+{
+	ee_defer(EE_RELAY);
+}
@@ -0,0 +1,272 @@
+/*
+ * mode_table.c
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ *
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <avr/pgmspace.h>
+#include "tm1637.h"
+#include "frostguard.h"
+#include "globals.h"
+
+/**
+ * table driven setting modes (menu, brightness, temperatures, date/time)
+ *
+ * each state of the table shows one value and lets the user change it:
+ *
+ * - value is shown (blinking if ST_BLINK)
+ * - KEY_UP/KEY_DOWN -> incr/decr value by step within min...max (wraps
+ *   around if ST_WRAP), shown not blinking
+ * - KEY_SET -> next state, or leave to MODE_WATCH if next is STATE_EXIT
+ * - KEY-SET_L -> leave to MODE_WATCH
+ *
+ * the optional hook of a state is called on HOOK_ENTER, HOOK_CHANGE, HOOK_DONE
+ * (KEY_SET in last state, may set globals.mode), HOOK_EXIT (any leave) and
+ * HOOK_MAX (returns max if the table holds max 0)
+ */
+typedef struct
+{
+	uint8_t		*value;		// value in RAM
+	uint8_t		min;
+	uint8_t		max;		// 0 = max from hook
+	uint8_t		step;
+	uint8_t		show;		// display function SHOW_xxx
+	uint8_t		arg;		// message number (SHOW_DIGIT) or first digit (SHOW_TEMP)
+	uint8_t		flags;		// ST_xxx
+	uint8_t		next;		// next state on KEY_SET
+	uint8_t		(*hook)(uint8_t event);
+
+} state_t;
+
+#define SHOW_MSG	0	// message number value
+#define SHOW_DIGIT	1	// message arg, value in last digit
+#define SHOW_TEMP	2	// arg in first digit, binary temperature value
+#define SHOW_YEAR	3	// year value + 1970
+#define SHOW_LEFT	4	// two digits left
+#define SHOW_RIGHT	5	// two digits right
+
+#define ST_WRAP		_BV(0)
+#define ST_BLINK	_BV(1)
+#define ST_COLON	_BV(2)	// colon blinking
+
+static uint8_t menu_item;
+static const uint8_t menu_next[] PROGMEM = { MODE_DATA, MODE_IRRIG, MODE_BRIGHT, MODE_TEMPS, MODE_DATIME };
+#define MAX_NEXT (sizeof(menu_next) - 1)
+
+static uint8_t menu_hook(uint8_t event);
+static uint8_t brightness_hook(uint8_t event);
+static uint8_t temp_hook(uint8_t event);
+
+/**
+ * state table, keep state numbers in sync
+ */
+#define ST_MENU		0
+#define ST_BRIGHT	1
+#define ST_HIGH		2
+#define ST_LOW		3
+#define ST_R_HIGH	4	// MODE_RESET: temperatures, then date/time
+#define ST_R_LOW	5
+#define ST_YEAR		6
+#define ST_MONTH	7
+#define ST_DAY		8
+#define ST_HOUR		9
+#define ST_MIN		10
+#define STATE_EXIT	0xFF
+
+static const state_t states[] PROGMEM = {
+	// menu entries are the first messages, see globals.h
+	{ &menu_item, 0, MAX_NEXT, 1, SHOW_MSG, 0, ST_WRAP, STATE_EXIT, menu_hook },
+	{ &globals.params.brightness, 0, MAX_BRIGHTNESS, 1, SHOW_DIGIT, 2, ST_WRAP | ST_BLINK, STATE_EXIT, brightness_hook },
+	{ (uint8_t *)&globals.params.temperatures.high, 0, BINTEMP(10), 1, SHOW_TEMP, _DSP_H, ST_BLINK, ST_LOW, temp_hook },
+	{ (uint8_t *)&globals.params.temperatures.low, 0, 0, 1, SHOW_TEMP, _DSP_L, ST_BLINK, STATE_EXIT, temp_hook },
+	{ (uint8_t *)&globals.params.temperatures.high, 0, BINTEMP(10), 1, SHOW_TEMP, _DSP_H, ST_BLINK, ST_R_LOW, temp_hook },
+	{ (uint8_t *)&globals.params.temperatures.low, 0, 0, 1, SHOW_TEMP, _DSP_L, ST_BLINK, ST_YEAR, temp_hook },
+	{ &datetime.year, 2021 - 1970, 0xFF, 1, SHOW_YEAR, 0, ST_BLINK, ST_MONTH, year_hook },
+	{ &datetime.month, 1, 12, 1, SHOW_LEFT, 0, ST_WRAP | ST_BLINK, ST_DAY, datetime_hook },
+	{ &datetime.day, 1, 0, 1, SHOW_RIGHT, 0, ST_WRAP | ST_BLINK, ST_HOUR, datetime_hook },
+	{ &datetime.hour, 0, 23, 1, SHOW_LEFT, 0, ST_WRAP | ST_BLINK | ST_COLON, ST_MIN, datetime_hook },
+	{ &datetime.min, 0, 59, 1, SHOW_RIGHT, 0, ST_WRAP | ST_BLINK | ST_COLON, STATE_EXIT, datetime_hook }
+};
+
+/**
+ * first state per mode (MODE_WATCH, MODE_IRRIG, MODE_DATA are not table driven)
+ */
+static const uint8_t first_state[] PROGMEM = {
+	ST_R_HIGH, ST_HIGH, ST_YEAR, STATE_EXIT, ST_MENU, STATE_EXIT, ST_BRIGHT, STATE_EXIT
+};
+
+static uint8_t state;
+
+/**
+ * current state of the table modes (globals.submode stays 1), for the trace
+ */
+uint8_t table_state()
+{
+	return state;
+}
+
+static uint8_t state_hook(uint8_t event)
+{
+	uint8_t (*hook)(uint8_t) = pgm_read_ptr(&states[state].hook);
+
+	return hook != NULL ? hook(event) : 0;
+}
+
+static uint8_t state_max()
+{
+	register uint8_t max = pgm_read_byte(&states[state].max);
+
+	return max != 0 ? max : state_hook(HOOK_MAX);
+}
+
+/**
+ * show value of current state
+ */
+static void state_show(uint8_t dsp_stat)
+{
+	register uint8_t value = *(uint8_t *)pgm_read_ptr(&states[state].value);
+	register uint8_t arg = pgm_read_byte(&states[state].arg);
+	register uint16_t yy;
+
+	switch (pgm_read_byte(&states[state].show)) {
+		case SHOW_MSG:
+			TM1637_display_msg_P(messages + 4 * value);
+			break;
+		case SHOW_DIGIT:
+			TM1637_display_msg_P(messages + 4 * arg);
+			TM1637_display_digit(3, value);
+			break;
+		case SHOW_TEMP:
+			displayTemp((int8_t)value);
+			TM1637_display_digit(0, arg);
+			break;
+		case SHOW_YEAR:
+			yy = value + 1970;
+			showDateTime((uint8_t)(yy / 100), (uint8_t)(yy % 100));
+			break;
+		case SHOW_LEFT:
+			showDateTime(value, -1);
+			break;
+		case SHOW_RIGHT:
+			showDateTime(-1, value);
+			break;
+	}
+	globals.dsp_stat = dsp_stat;
+}
+
+/**
+ * enter current state, value is limited to min...max
+ */
+static void state_enter()
+{
+	register uint8_t *value = pgm_read_ptr(&states[state].value);
+	register uint8_t flags = pgm_read_byte(&states[state].flags);
+	register uint8_t min = pgm_read_byte(&states[state].min);
+	register uint8_t max;
+
+	state_hook(HOOK_ENTER);
+	max = state_max();
+	if (*value < min) {
+		*value = min;
+	} else if (*value > max) {
+		*value = max;
+	}
+	globals.col_stat = flags & ST_COLON ? DSP_BLINK : DSP_OFF;
+	state_show(flags & ST_BLINK ? DSP_BLINK : DSP_ON);
+}
+
+/**
+ * change value of current state by step
+ */
+static void state_change(uint8_t up)
+{
+	register uint8_t *value = pgm_read_ptr(&states[state].value);
+	register uint8_t wrap = pgm_read_byte(&states[state].flags) & ST_WRAP;
+	register uint8_t step = pgm_read_byte(&states[state].step);
+	register uint8_t min = pgm_read_byte(&states[state].min);
+	register uint8_t max = state_max();
+	register uint8_t v = *value;
+
+	if (up) {
+		v = v <= max - step ? v + step : (wrap ? min : v);
+	} else {
+		v = v >= min + step ? v - step : (wrap ? max : v);
+	}
+	if (v != *value) {
+		*value = v;
+		state_hook(HOOK_CHANGE);
+	}
+	state_show(DSP_ON);
+}
+
+uint8_t	mode_table(uint8_t key)
+{
+	register uint8_t rc = MDS_RUN;
+	register uint8_t next;
+
+	if (globals.submode == 0) {
+		state = pgm_read_byte(&first_state[globals.mode]);
+		globals.submode = 1;
+		state_enter();
+
+	} else if (globals.submode == SUBMODE_EXIT) {
+		globals.mode = MODE_WATCH;
+		rc = MDS_DONE;
+
+	} else if (key == KEY_UP || key == KEY_DOWN) {
+		state_change(key == KEY_UP);
+
+	} else if (key == KEY_SET) {
+		next = pgm_read_byte(&states[state].next);
+		if (next == STATE_EXIT) {
+			globals.mode = MODE_WATCH;
+			state_hook(HOOK_DONE);
+			rc = MDS_DONE;
+		} else {
+			state = next;
+			state_enter();
+		}
+	}
+	if (rc == MDS_DONE) {
+		state_hook(HOOK_EXIT);
+		globals.submode = 0;
+		globals.dsp_stat = globals.col_stat = DSP_OFF;
+	}
+	return rc;
+}
+
+/**
+ * menu: start at first item, KEY_SET selects the mode of the item
+ */
+static uint8_t menu_hook(uint8_t event)
+{
+	if (event == HOOK_ENTER) {
+		menu_item = 0;
+	} else if (event == HOOK_DONE) {
+		globals.mode = pgm_read_byte(&menu_next[menu_item]);
+	}
+	return 0;
+}
+
+static uint8_t brightness_hook(uint8_t event)
+{
+	if (event == HOOK_CHANGE) {
+		TM1637_set_brightness(globals.params.brightness);
+	}
+	return 0;
+}
+
+/**
+ * temperatures: low not above high, also if left after lowering high
+ */
+static uint8_t temp_hook(uint8_t event)
+{
+	if (event == HOOK_EXIT && globals.params.temperatures.low > globals.params.temperatures.high) {
+		globals.params.temperatures.low = globals.params.temperatures.high;
+	}
+	return event == HOOK_MAX ? (uint8_t)globals.params.temperatures.high : 0;
+}
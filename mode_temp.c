@@ -11,69 +11,6 @@
 #include "frostguard.h"
 #include "globals.h"
 
-/**
- * set threshold temperatures mode
- *
- * - show "H" in first digit and high temperature (blinking)
- * - KEY_UP/KEY_DOWN -> incr/decr high temperature (not blinking)
- * - KEY_SET -> show "L" in first digit and high low temperature (blinking)
- * - KEY_UP/KEY_DOWN -> incr/decr low temperature (not blinking)
- * - KEY_SET -> store high/low temperatures, display off and leave
- */
-uint8_t mode_temperatures(uint8_t key)
-{
-	uint8_t	rc = MDS_RUN;
-	uint8_t	dir;
-	
-	switch (globals.submode) {
-		case 0:
-			globals.dsp_stat = DSP_BLINK;
-			displayTemp((int)globals.params.temperatures.high);
-			TM1637_display_digit(0, _DSP_H);
-			globals.submode++;
-			break;
-		case 1:
-			if (key == KEY_UP || key == KEY_DOWN) {
-				globals.dsp_stat = DSP_ON;
-				dir = key == KEY_UP ? (globals.params.temperatures.high < 20 ? 1 : 0) : (globals.params.temperatures.high > 0 ? -1 : 0);
-				if (dir != 0) {
-					globals.params.temperatures.high += dir;
-					displayTemp((int)globals.params.temperatures.high);	// DSP_ON
-					TM1637_display_digit(0, _DSP_H);
-				}
-			} else if (key == KEY_SET) {
-				globals.submode++;
-			}
-			break;
-		case 2:
-			globals.dsp_stat = DSP_BLINK;
-			displayTemp((int)globals.params.temperatures.low);
-			TM1637_display_digit(0, _DSP_L);
-			globals.submode++;
-			break;
-		case 3:
-			if (key == KEY_UP || key == KEY_DOWN) {
-				globals.dsp_stat = DSP_ON;
-				dir = key == KEY_UP ? (globals.params.temperatures.low < 20 ? 1 : 0) : (globals.params.temperatures.low > 0 ? -1 : 0);
-				if (dir != 0) {
-					globals.params.temperatures.low += dir;
-					displayTemp((int)globals.params.temperatures.low);	// DSP_ON
-					TM1637_display_digit(0, _DSP_L);
-				}
-			} else if (key == KEY_SET) {
-				globals.submode = SUBMODE_EXIT;
-			}
-			break;
-		case SUBMODE_EXIT:
-			globals.dsp_stat = DSP_OFF;
-			globals.mode = MODE_WATCH;
-			globals.submode = 0;
-			rc = MDS_DONE;
-			break;
-	}
-	return rc;
-}
-
 /**
  * convert number to display / ascii representation
  *
@@ -146,11 +83,11 @@ void displayTemp(int16_t temperature)
 			break;
 		case DS18x20_NO_RESET:
 			globals.dsp_stat = DSP_BLINK;
-			TM1637_display_msg(MSG_no_r);
+			TM1637_display_msg_P(MSG_no_r);
 			break;
 		case DS18x20_NO_DATA:
 			globals.dsp_stat = DSP_BLINK;
-			TM1637_display_msg(MSG_no_d);
+			TM1637_display_msg_P(MSG_no_d);
 			break;
 		default:
 			globals.dsp_stat = DSP_ON;
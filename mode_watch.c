@@ -8,29 +8,268 @@
  */ 
 #include <stdint.h>
 #include <avr/io.h>
+#include <util/crc16.h>
 #include "ds18x20.h"
 #include "tm1637.h"
 #include "frostguard.h"
 #include "globals.h"
+#include "trace.h"
+#include "vcc.h"
 
 /**
  * watch temperature mode
  *
  * - display off
  * - start measurement, colon on
- * - after CONVERSION_TIME
+ *   - parasite powered sensor: 200[ms] precharge, strong pullup during
+ *     conversion
+ *   - externally powered sensor: start at once, poll conversion complete
+ * - after CONVERSION_TIME (or conversion complete)
  *   - colon off
  *   - get temperature
- * - KEY_SET -> show temperature 10[s]
+ *   - irrigation core (irrigation.c):
+ *   - filter temperature, calculate irrigation mode from filtered temperature
+ *   - start pulse irrigation early if the temperature trend predicts the
+ *     low threshold temperature within params.lead minutes
+ *   - next measurement after params.interval_min...params.interval_max
+ *     seconds depending on temperature margin and trend (bounds of older
+ *     eeprom data are lowered to CACHE_MAX_AGE on init)
+ *   - valid reading goes to the temperature cache globals.tcache
+ *   - supply voltage read at the end of each measurement, also if the
+ *     reading failed; below params.vcc_low the pending state is flushed
+ *     into eeprom once and the safe state is entered: relay off, no eeprom
+ *     writes (ee_update(), serial commands refused), measurement every
+ *     interval_max seconds, KEY_SET shows "Lo U"; left above
+ *     params.vcc_low + VCC_HYST
+ * - telemetry record after each measurement if params.telemetry is set
+ * - sensor failure: retry at once in bursts of SENSOR_BURST, next burst
+ *   after interval_min seconds, irrigation goes on in the last mode; after
+ *   SENSOR_FAIL_LIMIT failures in a row a fault event is logged and the
+ *   relay follows params.fail_policy until the next valid reading
+ * - KEY_SET -> show cached temperature 10[s] at once, blinking while older
+ *   than CACHE_FRESH seconds; a stale cache starts a new measurement, the
+ *   fresh reading replaces the blinking value after CONVERSION_TIME
+ * - irrigation state is saved each tick in .noinit RAM; after a watchdog
+ *   or brown-out reset irrigation mode and pulse phase are restored, the
+ *   relay resumes at the first tick (no precharge / conversion wait)
  * - KEY-SET_L -> (global.submode = SUBMODE_EXIT in frostguard.c) -> MODE_MENU
  * 
  */
-static uint8_t measure_count;
+static uint16_t measure_count;
+static uint16_t measure_period = TEN_SECONDS;
 static uint8_t display_count;
 static int16_t temp = DS18x20_NO_VALUE;
-static uint8_t irri_mode = 0;
-static uint8_t pulse_timer = 0;
-static uint16_t irri_timer = 0;
+static uint8_t fail_count;		// failed readings in a row
+static uint8_t warm_pending;	// restore warm state at init
+
+irri_t irri;	// irrigation core state (irrigation.c)
+uint8_t conversion_time;	// sensor conversion time [ticks], from DS18x20_cvt
+warm_t warm __attribute__((section(".noinit")));
+
+/**
+ * checksum of the warm restart state
+ */
+static uint8_t warm_sum()
+{
+	register uint8_t *p = (uint8_t *)&warm;
+	register uint8_t crc = WARM_MAGIC;
+
+	while (p < &warm.check) {
+		crc = _crc8_ccitt_update(crc, *p++);
+	}
+	return crc;
+}
+
+/**
+ * save irrigation state for a warm restart (each tick)
+ */
+static void warm_save()
+{
+	warm.timestamp = globals.params.timestamp;
+	warm.filtered = irri.filtered;
+	warm.irri_mode = irri.irri_mode;
+	warm.pulse_timer = irri.pulse_timer;
+	warm.irri_timer = irri.irri_timer;
+	warm.check = warm_sum();
+}
+
+/**
+ * check warm restart state after reset (main), returns 1 if irrigation is
+ * resumed; the clock goes on from the saved timestamp whenever the state
+ * is valid (also without irrigation)
+ */
+uint8_t warm_init(uint8_t mcusr)
+{
+	warm_pending = 0;
+	if ((mcusr & (_BV(WDRF) | _BV(BORF))) && warm.check == warm_sum()) {
+		if (warm.timestamp > globals.params.timestamp) {
+			globals.params.timestamp = warm.timestamp;
+		}
+		if (warm.irri_mode > 0 && warm.restarts < WARM_RETRIES) {
+			warm.restarts++;
+			warm_pending = 1;
+		}
+	}
+	if (!warm_pending) {
+		warm.restarts = 0;
+		warm.irri_mode = 0;
+	}
+	warm.check = warm_sum();
+	return warm_pending;
+}
+
+/**
+ * load irrigation pulse profile from eeprom into the irrigation settings
+ *
+ * unset entries are set to the default 60[s] on / (n - 1) x 30[s] off
+ */
+void profile_load()
+{
+	profile_t profile[PROFILE_BANDS];
+	register uint8_t i;
+
+	eeprom_read_block(profile, eedata.profile, sizeof(profile));
+	for (i = 0; i < PROFILE_BANDS; i++) {
+		if (profile[i].on == 0 || profile[i].on == EEUNSET) {
+			profile[i].on = SIXTY_SECONDS / TEN_SECONDS;
+			profile[i].off = i * (THIRTY_SECONDS / TEN_SECONDS);
+		}
+		irri.cfg.pulse_on[i] = profile[i].on;
+		irri.cfg.pulse_off[i] = profile[i].off;
+	}
+	ee_update(profile, eedata.profile, sizeof(profile));
+}
+
+/**
+ * age of cached temperature [s], 0xFFFF = no valid reading
+ */
+uint16_t tcache_age()
+{
+	register uint32_t age = globals.params.timestamp - globals.tcache.stamp;
+
+	if (!globals.tcache.valid || globals.params.timestamp < globals.tcache.stamp || age > 0xFFFE) {
+		return 0xFFFF;
+	}
+	return (uint16_t)age;
+}
+
+/**
+ * supply voltage check, enter / leave safe state, returns 1 in safe state
+ */
+static uint8_t vcc_check()
+{
+	register uint8_t vcc = globals.vcc = vcc_read();
+
+	if (vcc < globals.params.vcc_min) {
+		globals.params.vcc_min = vcc;	// saved with the next params write
+	}
+	if (globals.vcc_safe) {
+		globals.vcc_safe = vcc < globals.params.vcc_low + VCC_HYST;
+	} else if (vcc < globals.params.vcc_low) {
+		/*
+		 * flush pending state once, then no more eeprom writes
+		 */
+		irrigation(0);
+		histogram_flush();
+		ee_close();		// written by the main loop in the safe state too
+		globals.vcc_safe = 1;
+	}
+	return globals.vcc_safe;
+}
+
+/**
+ * telemetry record of the measurement (uart line is free, no conversion)
+ */
+static void measure_telemetry()
+{
+	register uint8_t flags = 0;
+
+	if (!globals.params.telemetry) {
+		return;
+	}
+	if (IRRI_IS_ON()) {
+		flags |= TLM_RELAY;
+	}
+	if (fail_count > 0) {
+		flags |= TLM_FAULT;
+	}
+	if (fail_count >= SENSOR_FAIL_LIMIT && globals.params.fail_policy != FAIL_KEEP) {
+		flags |= TLM_FAILSAFE;
+	}
+	if (globals.vcc_safe) {
+		flags |= TLM_VCC;
+	}
+	telemetry(flags);
+}
+
+/**
+ * failed reading: retry burst or wait for the next burst, fault event on
+ * SENSOR_FAIL_LIMIT failures in a row
+ */
+static void measure_fail(uint8_t cause)
+{
+	globals.col_stat = DSP_OFF;
+	globals.faults.retries++;
+	if (fail_count < 0xFF) {
+		fail_count++;
+	}
+	if (fail_count == SENSOR_FAIL_LIMIT) {
+		globals.faults.faults++;
+		if (!globals.vcc_safe) {
+			store_fault(cause);
+		}
+	}
+	if (fail_count % SENSOR_BURST != 0) {
+		measure_count = 0;	// retry at once
+	} else {
+		measure_period = irri.cfg.interval_min * ONE_SECOND;
+		measure_count = CONVERSION_TIME + 3;
+	}
+	measure_telemetry();
+}
+
+/**
+ * read temperature after conversion, irrigation decision by irrigation core
+ */
+static void measure_read()
+{
+	register uint8_t mode = irri.irri_mode;
+	register uint8_t safe;
+
+	temp = DS18x20_readtemp();
+	safe = vcc_check();
+	if (temp == DS18x20_NO_DATA || temp < BINTEMP(-20.0) || temp >= BINTEMP(40.0)) {
+		measure_fail(temp == DS18x20_NO_DATA ? FAULT_DATA : FAULT_RANGE);
+		return;
+	}
+	if (fail_count > 0) {
+		globals.faults.recoveries++;
+		fail_count = 0;
+	}
+	warm.restarts = 0;
+	globals.tcache.value = (int8_t)temp;
+	globals.tcache.stamp = globals.params.timestamp;
+	globals.tcache.valid = 1;
+	globals.col_stat = DSP_OFF;
+	measure_count++;
+	if (safe) {
+		measure_period = irri.cfg.interval_max * ONE_SECOND;
+		measure_telemetry();
+		return;
+	}
+	histogram((int8_t)temp);
+	measure_period = irri_sample(&irri, (int8_t)temp, (uint16_t)globals.params.timestamp);
+	if (irri.irri_mode != mode) {
+		if (irri.irri_mode == 0) {
+			irrigation_save();
+		} else if (mode == 0) {
+			irrigation_night();
+		}
+		TRACE_WATCH(irri.filtered, irri.irri_mode);
+	}
+	store_event(irri.filtered, irri.irri_mode, irri.eta);
+	measure_telemetry();
+}
 
 uint8_t	mode_watch(uint8_t key)
 {
@@ -42,6 +281,27 @@ uint8_t	mode_watch(uint8_t key)
 		 */
 		measure_count = 0;
 		display_count = 1;
+		conversion_time = (DS18x20_cvt + 9) / 10;
+		irri.cfg.low = globals.params.temperatures.low;
+		irri.cfg.high = globals.params.temperatures.high;
+		irri.cfg.lead = globals.params.lead;
+		if (globals.params.interval_max > CACHE_MAX_AGE) {
+			globals.params.interval_max = CACHE_MAX_AGE;
+			if (globals.params.interval_min > CACHE_MAX_AGE) {
+				globals.params.interval_min = CACHE_MAX_AGE;
+			}
+		}
+		irri.cfg.interval_min = globals.params.interval_min;
+		irri.cfg.interval_max = globals.params.interval_max;
+		irri_init(&irri);
+		if (warm_pending) {
+			irri.filtered = warm.filtered;
+			irri.irri_mode = warm.irri_mode;
+			irri.pulse_timer = warm.pulse_timer;
+			irri.irri_timer = warm.irri_timer;
+			warm_pending = 0;
+		}
+		measure_period = globals.params.interval_min * ONE_SECOND;
 		globals.dsp_stat = DSP_ON;
 		globals.col_stat = DSP_OFF;
 		TM1637_clear();
@@ -54,60 +314,57 @@ uint8_t	mode_watch(uint8_t key)
 		globals.mode = MODE_MENU;
 		globals.submode = 0;
 		globals.col_stat = DSP_OFF;
-		irri_mode = 0;
-		IRRI_OFF();
+		VCC_STOP();
+		irrigation(0);
+		irrigation_save();
+		histogram_flush();
+		warm.irri_mode = 0;	// no warm restart outside watch mode
+		warm.check = warm_sum();
 		rc = MDS_DONE;
 		
 	} else { // globals.submode == 1
 		if (key == KEY_SET) {
 			display_count = 1;
+			if (tcache_age() > CACHE_FRESH && measure_count > CONVERSION_TIME + 2) {
+				measure_count = 0;	// refresh stale cache now
+			}
 		}
 		/*
 		 * temperature measurement
 		 */
+		if (   !DS18x20_parasite && measure_count > 2 && measure_count < CONVERSION_TIME + 2
+			&& DS18x20_readbit()) {
+			measure_count = CONVERSION_TIME + 2;	// conversion complete, read now
+		}
 		switch (measure_count) {
 			case 0:
 				globals.col_stat = DSP_ON;
-				DS18x20_PWRINIT();
-				DS18x20_PWRON();	// give sensor 200[ms] power
-				measure_count++;
-				break;
-				
-			case 2:
-				DS18x20_PWROFF();
+				if (DS18x20_parasite) {
+					DS18x20_PWRINIT();
+					DS18x20_PWRON();	// give sensor 200[ms] power
+					measure_count++;
+					break;
+				}
+				// external supply: no precharge
+				/* FALLTHRU */
+			case 2:
+				VCC_START();	// bandgap settles until the reading
+				DS18x20_PWROFF();
 				temp = DS18x20_startcv();
-				measure_count = temp == DS18x20_NO_RESET ? 0 : (measure_count + 1);
-				break;
-
-			case CONVERSION_TIME + 2:
-				temp = DS18x20_readtemp();
-				if (temp == DS18x20_NO_DATA || temp < BINTEMP(-20.0) || temp >= BINTEMP(40.0)) {
-					measure_count = 0;
+				if (temp == DS18x20_NO_RESET) {
+					vcc_check();	// no reading in this measurement
+					measure_fail(FAULT_RESET);
 				} else {
-					/*
-					 * calculate irrigation mode from temperature
-					 */
-					if ((int8_t)temp > globals.params.temperatures.high) {
-						// stop irrigation & pulse timer
-						irri_mode = pulse_timer = 0;
-					} else if ((int8_t)temp <= globals.params.temperatures.low) {
-						// start irrigation & pulse timer
-						irri_mode = pulse_timer = 1;
-					} else if (irri_mode >= 1) {
-						irri_mode = (int8_t)temp - globals.params.temperatures.low + 1;
-					}
-					store_event(temp, irri_mode);
-					globals.col_stat = DSP_OFF;
-					measure_count++;
+					measure_count = 3;
 				}
 				break;
 
-			case TEN_SECONDS:
-				measure_count = 0;
-				break;
-
 			default:
-				measure_count++;
+				if (measure_count == CONVERSION_TIME + 2) {
+					measure_read();
+				} else if (++measure_count >= measure_period) {
+					measure_count = 0;
+				}
 				break;
 		}
 		/*
@@ -116,50 +373,35 @@ uint8_t	mode_watch(uint8_t key)
 		if (temp > DS18x20_NO_VALUE) {	// error
 			globals.col_stat = DSP_OFF;
 			display_count = 1;
-		} else {
-			/*
-			 *  pulse irrigation from irri_mode
-			 *
-			 *   0: off
-			 *   1: constant on
-			 *   2: 60[s] on /     30[s] off
-			 *   3: 60[s] on / 2 x 30[s] off
-			 *   4: 60[s] on / 3 x 30[s] off
-			 *   ...
-			 */
-			if (pulse_timer == 0) {
-				// stop pulse timer
-				IRRI_OFF();
-				irri_timer = 0;
-			} else if (pulse_timer == 1) {
-				// on phase
-				if (irri_timer == 0) {
-					IRRI_ON();
-					irri_timer = SIXTY_SECONDS;
-				}
-				pulse_timer = irri_mode;
+		}
+		if (!globals.vcc_safe) {	// relay stays off in safe state
+			if (fail_count >= SENSOR_FAIL_LIMIT && globals.params.fail_policy != FAIL_KEEP) {
+				irrigation(globals.params.fail_policy == FAIL_IRRIGATE);
 			} else {
-				// off phase
-				if (irri_timer == 0) {
-					IRRI_OFF();
-					irri_timer = THIRTY_SECONDS;
-				}
-			}
-			if (irri_timer > 0) {
-				if (--irri_timer == 0) {
-					if (pulse_timer == 1) {
-						pulse_timer = irri_mode;
-					} else {
-						pulse_timer--;
-					}
-				}
+				// pulse irrigation from irri_mode by profile lookup table
+				irrigation(irri_pulse(&irri));
 			}
+			warm_save();
+		} else {
+			warm.timestamp = globals.params.timestamp;
+			warm.irri_mode = 0;	// no relay after a brown-out in safe state
+			warm.check = warm_sum();
 		}
 		if (display_count > TEN_SECONDS) {
 			display_count = 0;
 			TM1637_clear();
 		} else if (display_count > 0) {
-			displayTemp(temp);
+			if (globals.vcc_safe) {
+				TM1637_display_msg_P(MSG_Lo_U);
+				globals.dsp_stat = DSP_BLINK;
+			} else if (temp > DS18x20_NO_VALUE || !globals.tcache.valid) {
+				displayTemp(temp);
+			} else {
+				displayTemp(globals.tcache.value);
+				if (tcache_age() > CACHE_FRESH) {
+					globals.dsp_stat = DSP_BLINK;
+				}
+			}
 			display_count++;
 		}
 	}
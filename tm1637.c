@@ -142,6 +142,15 @@ TM1637_display_msg(const uint8_t msg[])
 	}
 }
 
+void
+TM1637_display_msg_P(const uint8_t *msg)
+{
+	for (uint8_t pos = 0; pos < TM1637_POSITION_MAX; pos++)
+	{
+		TM1637_display_digit(pos, pgm_read_byte(msg + pos));
+	}
+}
+
 void
 TM1637_display_colon(const uint8_t value)
 {
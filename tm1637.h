@@ -117,6 +117,11 @@ void TM1637_display_digit(const uint8_t position, const uint8_t digit);
  */
 void TM1637_display_msg(const uint8_t *msg);
 
+/**
+ * Display message in flash (PROGMEM) having TM1637_POSITION_MAX letters
+ */
+void TM1637_display_msg_P(const uint8_t *msg);
+
 /**
  * Display colon on/off.
  * value: 1 - on, 0 - off
@@ -0,0 +1,592 @@
+/*
+ * fleet.c
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ *
+ * host tool: ingest data transfers ("SEnd" / "nEu " / serial command d, n)
+ * and telemetry logs of many units into an event store, query it
+ *
+ *   gcc -O2 -Wall -o fleet fleet.c
+ *
+ *   fleet ingest [-u unit] store file...
+ *   fleet query [-u unit] [-f from] [-t to] [-d days] [-T temp] [-m mode]
+ *               [-s] [-F] store
+ *
+ * ingest
+ *   file       terminal log of the data transfer (JSON as sent by
+ *              perform_tx(), trailing ',' after each value, several
+ *              transfers per file possible, prompt / ok / er lines are
+ *              skipped) or telemetry log (':' records, see telemetry())
+ *   -u         unit id of files without "id" (telemetry logs, firmware
+ *              before the unit id), default 0
+ *
+ *   events of overlapping transfers of the same unit are stored once;
+ *   telemetry records are stored as events when irrigation mode or fault
+ *   flags change
+ *
+ * query
+ *   -u         unit id (default all units)
+ *   -f / -t    time range "YYYY-MM-DD[ HH:MM[:SS]]" (to is excluded)
+ *   -d         last days before now
+ *   -T         temperature below [C]
+ *   -m         irrigation mode at least
+ *   -s         irrigation starts only (irrigation mode > 0, previous
+ *              event of the unit irrigation mode 0 or fault)
+ *   -F         sensor fault events only
+ *
+ *   e.g. all irrigation starts below -2[C] during the last 30 days:
+ *   fleet query -d 30 -T -2 -s store
+ *
+ * store: directory, one file per unit "unit<id>.fgs", events sorted by
+ * timestamp in columns (timestamp, temperature, irrigation mode, eta,
+ * source), so a time range is found by binary search on the timestamp
+ * column and the other columns are read only for the range.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define MAX_UNITS	256
+#define STORE_MAGIC	"FGS1"
+
+#define EVENT_FAULT	0x80	// see frostguard.h
+#define TLM_FAULT	0x02
+#define TLM_FAILSAFE 0x04
+
+#define SRC_DUMP	0	// event from data transfer
+#define SRC_TLM		1	// irrigation mode / fault change of telemetry records
+
+typedef struct
+{
+	size_t		count;
+	size_t		size;
+	uint32_t	*ts;		// [s] since 1970-01-01 00:00:00
+	int8_t		*temp;		// binary temperature 0.5[]
+	uint8_t		*mode;		// irrigation mode, EVENT_FAULT | cause
+	uint8_t		*eta;		// predicted crossing [min]
+	uint8_t		*src;		// SRC_xxx
+
+} column_t;
+
+static column_t units[MAX_UNITS];
+
+/**
+ * append event to the columns of a unit
+ */
+static void add_event(column_t *c, uint32_t ts, int8_t temp, uint8_t mode, uint8_t eta, uint8_t src)
+{
+	if (c->count == c->size) {
+		c->size = c->size ? 2 * c->size : 256;
+		c->ts = realloc(c->ts, c->size * sizeof(uint32_t));
+		c->temp = realloc(c->temp, c->size);
+		c->mode = realloc(c->mode, c->size);
+		c->eta = realloc(c->eta, c->size);
+		c->src = realloc(c->src, c->size);
+		if (c->ts == NULL || c->temp == NULL || c->mode == NULL || c->eta == NULL || c->src == NULL) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	c->ts[c->count] = ts;
+	c->temp[c->count] = temp;
+	c->mode[c->count] = mode;
+	c->eta[c->count] = eta;
+	c->src[c->count] = src;
+	c->count++;
+}
+
+static column_t *sort_columns;
+
+static int compare_idx(const void *a, const void *b)
+{
+	const column_t *c = sort_columns;
+	size_t i = *(const size_t *)a, j = *(const size_t *)b;
+
+	if (c->ts[i] != c->ts[j]) {
+		return c->ts[i] < c->ts[j] ? -1 : 1;
+	}
+	if (c->src[i] != c->src[j]) {
+		return c->src[i] - c->src[j];
+	}
+	if (c->mode[i] != c->mode[j]) {
+		return c->mode[i] - c->mode[j];
+	}
+	if (c->temp[i] != c->temp[j]) {
+		return c->temp[i] - c->temp[j];
+	}
+	return i < j ? -1 : (i > j);
+}
+
+/**
+ * sort events of a unit by timestamp, drop duplicates (same timestamp,
+ * source, irrigation mode and temperature)
+ */
+static void sort_unique(column_t *c)
+{
+	size_t *idx = malloc(c->count * sizeof(size_t) + 1);
+	column_t out = { 0 };
+	size_t i, k;
+
+	if (idx == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	for (i = 0; i < c->count; i++) {
+		idx[i] = i;
+	}
+	sort_columns = c;
+	qsort(idx, c->count, sizeof(size_t), compare_idx);
+	for (i = 0; i < c->count; i++) {
+		k = idx[i];
+		if (   out.count > 0 && out.ts[out.count - 1] == c->ts[k] && out.src[out.count - 1] == c->src[k]
+			&& out.mode[out.count - 1] == c->mode[k] && out.temp[out.count - 1] == c->temp[k]) {
+			continue;
+		}
+		add_event(&out, c->ts[k], c->temp[k], c->mode[k], c->eta[k], c->src[k]);
+	}
+	free(idx);
+	free(c->ts);
+	free(c->temp);
+	free(c->mode);
+	free(c->eta);
+	free(c->src);
+	*c = out;
+}
+
+/**
+ * read / write unit file of the store
+ */
+static char *unit_path(const char *store, unsigned unit)
+{
+	static char path[4096];
+
+	snprintf(path, sizeof(path), "%s/unit%u.fgs", store, unit);
+	return path;
+}
+
+static int load_unit(const char *store, unsigned unit)
+{
+	column_t *c = &units[unit];
+	FILE *fp = fopen(unit_path(store, unit), "rb");
+	char magic[4];
+	uint32_t count;
+	size_t n;
+
+	if (fp == NULL) {
+		return errno == ENOENT ? 0 : -1;
+	}
+	if (fread(magic, 4, 1, fp) != 1 || memcmp(magic, STORE_MAGIC, 4) != 0 || fread(&count, 4, 1, fp) != 1) {
+		fprintf(stderr, "%s: no event store file\n", unit_path(store, unit));
+		fclose(fp);
+		return -1;
+	}
+	n = c->count;
+	while (c->count < n + count) {
+		add_event(c, 0, 0, 0, 0, 0);
+	}
+	if (   fread(c->ts + n, sizeof(uint32_t), count, fp) != count
+		|| fread(c->temp + n, 1, count, fp) != count || fread(c->mode + n, 1, count, fp) != count
+		|| fread(c->eta + n, 1, count, fp) != count || fread(c->src + n, 1, count, fp) != count) {
+		fprintf(stderr, "%s: truncated\n", unit_path(store, unit));
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+	return 1;
+}
+
+static int save_unit(const char *store, unsigned unit)
+{
+	column_t *c = &units[unit];
+	char tmp[4200];
+	FILE *fp;
+	uint32_t count = (uint32_t)c->count;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", unit_path(store, unit));
+	if ((fp = fopen(tmp, "wb")) == NULL) {
+		perror(tmp);
+		return -1;
+	}
+	fwrite(STORE_MAGIC, 4, 1, fp);
+	fwrite(&count, 4, 1, fp);
+	fwrite(c->ts, sizeof(uint32_t), count, fp);
+	fwrite(c->temp, 1, count, fp);
+	fwrite(c->mode, 1, count, fp);
+	fwrite(c->eta, 1, count, fp);
+	fwrite(c->src, 1, count, fp);
+	if (fclose(fp) != 0 || rename(tmp, unit_path(store, unit)) != 0) {
+		perror(unit_path(store, unit));
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * parse "YYYY-MM-DD[ HH:MM[:SS]]" (UTC), returns 0 on error
+ */
+static uint32_t parse_time(const char *s)
+{
+	struct tm tm;
+	int n;
+
+	memset(&tm, 0, sizeof(tm));
+	n = sscanf(s, "%d-%d-%d %d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec);
+	if (n != 3 && n < 5) {
+		return 0;
+	}
+	tm.tm_year -= 1900;
+	tm.tm_mon -= 1;
+	return (uint32_t)timegm(&tm);
+}
+
+static char *time_string(uint32_t ts)
+{
+	static char buffer[32];
+	time_t t = ts;
+	struct tm tm;
+
+	gmtime_r(&t, &tm);
+	strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm);
+	return buffer;
+}
+
+/**
+ * key / value of a line '  "key": value,' (value without quotes and ',')
+ */
+static int key_value(char *line, char **key, char **value)
+{
+	char *p = strchr(line, '"'), *q;
+
+	if (p == NULL || (q = strchr(p + 1, '"')) == NULL || q[1] != ':') {
+		return 0;
+	}
+	*q = 0;
+	*key = p + 1;
+	p = q + 2;
+	while (*p == ' ' || *p == '"') {
+		p++;
+	}
+	*value = p;
+	for (q = p + strlen(p); q > p && strchr(" \t\r\n,\"[{", q[-1]) != NULL; q--) {
+	}
+	*q = 0;
+	return 1;
+}
+
+typedef struct
+{
+	int			valid;
+	uint32_t	ts;
+	uint32_t	pc;
+	int8_t		temp;
+	uint8_t		mode;
+
+} dump_event_t;
+
+static void flush_event(dump_event_t *ev, unsigned unit, unsigned long *events)
+{
+	uint8_t eta = 0;
+
+	if (ev->valid && ev->ts != 0) {
+		if (ev->pc > ev->ts && (ev->pc - ev->ts) / 60 <= 0xFF) {
+			eta = (uint8_t)((ev->pc - ev->ts) / 60);
+		}
+		add_event(&units[unit], ev->ts, ev->temp, ev->mode, eta, SRC_DUMP);
+		(*events)++;
+	}
+	memset(ev, 0, sizeof(*ev));
+}
+
+/**
+ * telemetry record ':' tttttttt TT MM FF CC, returns 1 if valid
+ */
+static int parse_record(const char *line, uint8_t *data)
+{
+	uint8_t crc = 0;
+	unsigned i, b;
+	int bit;
+
+	if (line[0] != ':' || strspn(line + 1, "0123456789ABCDEF") != 16) {
+		return 0;
+	}
+	for (i = 0; i < 8; i++) {
+		if (sscanf(line + 1 + 2 * i, "%2x", &b) != 1) {
+			return 0;
+		}
+		data[i] = (uint8_t)b;
+		if (i < 7) {	// _crc8_ccitt_update()
+			crc ^= data[i];
+			for (bit = 0; bit < 8; bit++) {
+				crc = crc & 0x80 ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+			}
+		}
+	}
+	return crc == data[7];
+}
+
+/**
+ * ingest one file, returns number of events read
+ */
+static unsigned long ingest_file(const char *name, unsigned unit)
+{
+	FILE *fp = fopen(name, "r");
+	char line[512], *key, *value;
+	int in_ev = 0, last_mode = -1;
+	unsigned long events = 0, records = 0, bad = 0;
+	dump_event_t ev = { 0 };
+	uint8_t data[8], mode;
+
+	if (fp == NULL) {
+		perror(name);
+		return 0;
+	}
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		char *p = line + strspn(line, " \t>");
+
+		if (*p == ':') {
+			if (!parse_record(p, data)) {
+				bad++;
+				continue;
+			}
+			records++;
+			mode = data[5];
+			if (data[6] & (TLM_FAULT | TLM_FAILSAFE)) {
+				mode |= EVENT_FAULT;
+			}
+			if (mode != last_mode) {
+				add_event(&units[unit], (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 | data[2] << 8 | data[3],
+					(int8_t)data[4], mode, 0, SRC_TLM);
+				events++;
+				last_mode = mode;
+			}
+			continue;
+		}
+		if (*p == '{' && p[1] != '"' && in_ev == 0) {	// start of a transfer
+			continue;
+		}
+		if (*p == '}' && (p[1] == ']' || p[1] == '\r' || p[1] == '\n' || p[1] == 0)) {
+			flush_event(&ev, unit, &events);
+			if (p[1] != ',') {
+				in_ev = p[1] == ']' ? 0 : in_ev;
+			}
+			if (p == line) {	// end of a transfer
+				in_ev = 0;
+			}
+			continue;
+		}
+		if (!key_value(p, &key, &value)) {
+			continue;
+		}
+		if (!in_ev) {
+			if (strcmp(key, "id") == 0) {
+				unit = (unsigned)atoi(value) % MAX_UNITS;
+			} else if (strcmp(key, "ev") == 0) {
+				in_ev = 1;
+			}
+			continue;
+		}
+		if (strcmp(key, "n") == 0) {
+			flush_event(&ev, unit, &events);
+		} else if (strcmp(key, "ts") == 0) {
+			ev.ts = parse_time(value);
+		} else if (strcmp(key, "pc") == 0) {
+			ev.pc = parse_time(value);
+		} else if (strcmp(key, "tm") == 0) {
+			ev.temp = (int8_t)(atof(value) * 2 + (atof(value) < 0 ? -0.5 : 0.5));
+		} else if (strcmp(key, "im") == 0) {
+			ev.mode = (uint8_t)atoi(value);
+			ev.valid = 1;
+		} else if (strcmp(key, "fe") == 0) {
+			ev.mode = EVENT_FAULT | (uint8_t)atoi(value);
+			ev.valid = 1;
+		}
+	}
+	flush_event(&ev, unit, &events);
+	fclose(fp);
+	printf("%s: %lu events", name, events);
+	if (records > 0 || bad > 0) {
+		printf(" (%lu telemetry records, %lu bad)", records, bad);
+	}
+	printf("\n");
+	return events;
+}
+
+static int ingest(int argc, char *argv[])
+{
+	unsigned unit = 0, u;
+	size_t before[MAX_UNITS];
+	const char *store;
+	int opt, i, rc = 0;
+
+	while ((opt = getopt(argc, argv, "u:")) != -1) {
+		if (opt == 'u') {
+			unit = (unsigned)atoi(optarg) % MAX_UNITS;
+		} else {
+			return 2;
+		}
+	}
+	if (optind + 2 > argc) {
+		return 2;
+	}
+	store = argv[optind++];
+	if (mkdir(store, 0777) != 0 && errno != EEXIST) {
+		perror(store);
+		return 1;
+	}
+	for (u = 0; u < MAX_UNITS; u++) {
+		if (load_unit(store, u) < 0) {
+			return 1;
+		}
+		before[u] = units[u].count;
+	}
+	for (i = optind; i < argc; i++) {
+		ingest_file(argv[i], unit);
+	}
+	for (u = 0; u < MAX_UNITS; u++) {
+		if (units[u].count != before[u]) {
+			sort_unique(&units[u]);
+			printf("unit %u: %zu events (%zd new)\n", u, units[u].count, (ssize_t)units[u].count - (ssize_t)before[u]);
+			rc |= save_unit(store, u) != 0;
+		}
+	}
+	return rc;
+}
+
+/**
+ * first event at or after ts (binary search on the timestamp column)
+ */
+static size_t lower_bound(const column_t *c, uint32_t ts)
+{
+	size_t lo = 0, hi = c->count, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (c->ts[mid] < ts) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+static int query(int argc, char *argv[])
+{
+	int opt, unit = -1, starts = 0, faults = 0, min_mode = 0, use_temp = 0;
+	uint32_t from = 0, to = UINT32_MAX;
+	int8_t below = 0;
+	unsigned long matches = 0;
+	struct timespec t0, t1;
+	unsigned u;
+	size_t i, end;
+
+	while ((opt = getopt(argc, argv, "u:f:t:d:T:m:sF")) != -1) {
+		switch (opt) {
+			case 'u':
+				unit = atoi(optarg) % MAX_UNITS;
+				break;
+			case 'f':
+				if ((from = parse_time(optarg)) == 0) {
+					return 2;
+				}
+				break;
+			case 't':
+				if ((to = parse_time(optarg)) == 0) {
+					return 2;
+				}
+				break;
+			case 'd':
+				from = (uint32_t)(time(NULL) - atol(optarg) * 86400L);
+				break;
+			case 'T':
+				below = (int8_t)(atof(optarg) * 2);
+				use_temp = 1;
+				break;
+			case 'm':
+				min_mode = atoi(optarg);
+				break;
+			case 's':
+				starts = 1;
+				break;
+			case 'F':
+				faults = 1;
+				break;
+			default:
+				return 2;
+		}
+	}
+	if (optind + 1 != argc) {
+		return 2;
+	}
+	for (u = 0; u < MAX_UNITS; u++) {
+		if ((unit < 0 || (unsigned)unit == u) && load_unit(argv[optind], u) < 0) {
+			return 1;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (u = 0; u < MAX_UNITS; u++) {
+		const column_t *c = &units[u];
+
+		end = lower_bound(c, to);
+		for (i = lower_bound(c, from); i < end; i++) {
+			uint8_t mode = c->mode[i];
+
+			if (faults ? !(mode & EVENT_FAULT) : (mode & EVENT_FAULT) || mode < min_mode) {
+				continue;
+			}
+			if (use_temp && c->temp[i] >= below) {
+				continue;
+			}
+			if (starts && (mode == 0 || (i > 0 && c->mode[i - 1] > 0 && !(c->mode[i - 1] & EVENT_FAULT)))) {
+				continue;
+			}
+			matches++;
+			printf("%u\t%s\t%.1f\t%s%u", u, time_string(c->ts[i]), c->temp[i] / 2.0,
+				mode & EVENT_FAULT ? "fault " : "", mode & ~EVENT_FAULT);
+			if (c->eta[i] > 0) {
+				printf("\tpc %s", time_string(c->ts[i] + c->eta[i] * 60U));
+			}
+			printf("%s\n", c->src[i] == SRC_TLM ? "\ttelemetry" : "");
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	fprintf(stderr, "%lu events (%.3f[ms])\n", matches,
+		(t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+	return 0;
+}
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage: fleet ingest [-u unit] store file...\n"
+		"       fleet query [-u unit] [-f from] [-t to] [-d days] [-T temp] [-m mode] [-s] [-F] store\n");
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	int rc = 2;
+
+	if (argc < 2) {
+		usage();
+	}
+	optind = 2;
+	if (strcmp(argv[1], "ingest") == 0) {
+		rc = ingest(argc, argv);
+	} else if (strcmp(argv[1], "query") == 0) {
+		rc = query(argc, argv);
+	}
+	if (rc == 2) {
+		usage();
+	}
+	return rc;
+}
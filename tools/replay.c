@@ -0,0 +1,459 @@
+/*
+ * replay.c
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ *
+ * host tool: replay recorded temperature series through the irrigation core
+ * (irrigation.c) at maximum speed
+ *
+ *   gcc -O2 -Wall -Isim -I.. -o replay replay.c ../irrigation.c -lm
+ *
+ *   replay [-H high] [-L low] [-l lead] [-i min,max] [-r mode,on,off]...
+ *          [-b brightness] [-k keys] [-B budget] [-n noise] [-f family]
+ *          [-x] [-v] file.csv...
+ *
+ *   -H / -L    threshold temperatures [C] (default 3.0 / 1.0)
+ *   -l         predictive irrigation start lead time [min] (default 10, 0 = off)
+ *   -i         measurement interval bounds [s] (default 10,120, max
+ *              CACHE_MAX_AGE as in the firmware)
+ *   -r         pulse profile of irrigation mode 1...8, on / off phase [s]
+ *   -b         display brightness 0...7 (default 5)
+ *   -k         KEY_SET presses per day showing the temperature 10[s] (default 0)
+ *   -B         energy budget [uAh/day], exit code 1 if a file exceeds it
+ *   -n         sensor noise [C]: each reading is off by up to +/- noise
+ *              (uniform, same pseudo random series for each file)
+ *   -f         sensor family s20 (DS18S20, default) or b20 (DS18B20 / DS1822
+ *              at 9 bit), conversion time DS18x20_CVT_S20 / DS18x20_CVT_B20
+ *   -x         externally powered sensor: no precharge, start of conversion
+ *              in the first tick of a measurement, conversion complete
+ *              polled each tick
+ *   -v         print relay timeline and eeprom events
+ *
+ * exit code 1 also if the relay stays on longer than the longest on phase
+ * of the profile while the irrigation mode has an off phase (pulse check),
+ * e.g. regression case mode 1 with off phase:
+ *
+ *   replay -r 1,60,30 mode1.csv
+ *
+ * "saved by filter" compares the event writes with those of the unfiltered
+ * temperature (same predicted start); mode1.csv is noise free, the filter
+ * effect shows with noise, e.g. replay -n 0.25 mode1.csv
+ *
+ * csv lines: <timestamp>,<temperature>, timestamp [s] since 1970-01-01
+ * 00:00:00, temperature [C]; other lines (header, comments) are skipped.
+ * The temperature is interpolated linearly between the lines and rounded
+ * to the sensor resolution of 0.5[C].
+ *
+ * The watch mode timing is simulated in 100[ms] ticks as in mode_watch.c:
+ * sensor reading CONVERSION_TIME ticks (conversion time of the family,
+ * rounded up) after start of conversion, which follows PRECHARGE ticks of
+ * sensor power (parasite power) or starts the measurement (externally
+ * powered), measurement period from the irrigation core, pulse timer every
+ * tick. Each file is replayed with a fresh irrigation state.
+ *
+ * Energy model: each tick the supply current of the simulated states is
+ * accumulated - CPU idle sleep plus active time of the tick ISR and the
+ * 1-wire transfers, display (temperature digits after start / KEY_SET and
+ * colon while measuring) at the display brightness, sensor power phase
+ * (DS18x20_PWRON() before and during conversion), relay coil and eeprom
+ * writes. The currents below are estimates; adjust them to measured values.
+ * The energy report is computed in integers from the simulated ticks only,
+ * so it is reproducible and may be used as regression gate (-B).
+ */
+#define SIM_HARNESS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "irrigation.h"
+#include "frostguard.h"
+#include "ds18x20.h"
+
+#define PRECHARGE	2	// sensor power ticks before start of conversion
+#define TICK_US		100000UL	// [us]
+#define KEY_TICKS	100	// temperature display after KEY_SET (TEN_SECONDS)
+
+/**
+ * supply currents [uA] and active times [us], ATtiny85 at 1[MHz] / 5[V],
+ * TM1637 4 digit LED display, DS18S20, 5[V] relay module
+ */
+#define I_CPU_IDLE		350		// idle sleep, timer0 running
+#define I_CPU_ACTIVE	1100
+#define T_TICK			1500	// active time of tick ISR: keys, blinker, mode dispatch
+#define T_SENSOR		15000	// active time per reading: 1-wire start conversion + read
+#define T_POLL			200		// active time per conversion complete poll (externally powered)
+#define I_PRECHARGE		1000	// sensor power phase before conversion
+#define I_CONVERT		1500	// sensor conversion, for the conversion time of the family
+#define I_DISPLAY_OFF	150		// TM1637 display off
+#define I_SEGMENT		8000	// one lit segment at duty 16/16
+#define SEGMENTS_TEMP	18		// lit segments showing a temperature
+#define SEGMENTS_COLON	2
+#define I_RELAY			70000	// relay coil
+#define I_EEPROM		2500	// eeprom write (CPU waiting included)
+#define T_EEPROM		3400	// per byte written
+#define EE_EVENT		10		// bytes changed per event: event_t, params write index and timestamp
+#define EE_SAVE			8		// bytes changed per relay accounting save (irrigation stop)
+#define EE_HISTO		2		// bytes changed per histogram flush (hourly)
+
+/**
+ * TM1637 pulse width [1/16] per brightness
+ */
+static const uint8_t duty[] = { 1, 2, 4, 10, 11, 12, 13, 14 };
+
+enum { E_CPU, E_SENSOR, E_DISPLAY, E_RELAY, E_EEPROM, E_COUNT };
+static const char *e_names[E_COUNT] = { "cpu", "sensor", "display", "relay", "eeprom" };
+
+typedef struct
+{
+	long	ts;			// [s]
+	double	temp;		// [C]
+
+} sample_t;
+
+static irri_config_t config = {
+	.low = 2,			// 1.0[C]
+	.high = 6,			// 3.0[C]
+	.lead = DEFAULT_LEAD,
+	.interval_min = DEFAULT_INTERVAL_MIN,
+	.interval_max = DEFAULT_INTERVAL_MAX
+};
+static int verbose = 0;
+static unsigned brightness = 5;		// DEFAULT_BRIGHTNESS
+static unsigned keys_per_day = 0;
+static double budget = 0;			// [uAh/day], 0 = none
+static unsigned precharge = PRECHARGE;	// 0 = externally powered sensor
+static unsigned cvt = DS18x20_CVT_S20;	// sensor conversion time [10ms] (DS18x20_cvt)
+static double noise = 0;			// sensor noise [C]
+
+/**
+ * format timestamp + tick
+ */
+static char *ts_string(long ts, unsigned tick)
+{
+	static char buffer[80];
+	time_t t = ts;
+	struct tm tm;
+
+	gmtime_r(&t, &tm);
+	snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d.%u",
+		tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, tick);
+	return buffer;
+}
+
+static char *hms(unsigned long secs)
+{
+	static char buffer[32];
+
+	snprintf(buffer, sizeof(buffer), "%lu:%02lu:%02lu", secs / 3600, secs / 60 % 60, secs % 60);
+	return buffer;
+}
+
+/**
+ * read csv file, returns number of samples
+ */
+static size_t read_csv(const char *name, sample_t **samples)
+{
+	FILE *fp = fopen(name, "r");
+	char line[256];
+	size_t n = 0, size = 0;
+	sample_t s;
+
+	*samples = NULL;
+	if (fp == NULL) {
+		perror(name);
+		return 0;
+	}
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "%ld ,%lf", &s.ts, &s.temp) != 2) {
+			continue;
+		}
+		if (n > 0 && s.ts <= (*samples)[n - 1].ts) {
+			fprintf(stderr, "%s: timestamp %ld not ascending, skipped\n", name, s.ts);
+			continue;
+		}
+		if (n == size) {
+			size = size ? 2 * size : 4096;
+			*samples = realloc(*samples, size * sizeof(sample_t));
+			if (*samples == NULL) {
+				perror("realloc");
+				exit(1);
+			}
+		}
+		(*samples)[n++] = s;
+	}
+	fclose(fp);
+	return n;
+}
+
+/**
+ * replay samples, print report, returns 1 if over energy budget or pulse
+ * check failed
+ */
+static int replay(const char *name, const sample_t *samples, size_t n)
+{
+	irri_t irri;
+	size_t idx = 0;
+	unsigned long long ticks, tick, on_ticks = 0;
+	unsigned long switches = 0, events = 0, readings = 0, ee_bytes = 0, pulse_errors = 0;
+	unsigned on_run = 0, max_on = 0;
+	uint8_t pulse_mode = 0;
+	unsigned long long charge[E_COUNT] = { 0 };	// [uA * us]
+	unsigned long long key_period = keys_per_day ? 864000ULL / keys_per_day : 0;
+	unsigned display_count = KEY_TICKS;	// temperature shown after start of watch mode
+	double days, total = 0;
+	int i;
+	uint16_t measure_count = 0, measure_period = config.interval_min * IRRI_TICKS;
+	uint16_t sample_tick = (cvt + 9) / 10 + precharge;	// CONVERSION_TIME after start of conversion
+	unsigned long long converting;	// [us] of the conversion in this tick
+	uint8_t relay = 0, on;
+	int8_t t, last_temp = 0, min_protected = 127, min_unprotected = 127;
+	uint8_t last_mode = IRRI_NO_EVENT;
+	long ts;
+	double temp;
+	clock_t start;
+	uint32_t seed = 1;
+
+	memset(&irri, 0, sizeof(irri));
+	irri.cfg = config;
+	irri_init(&irri);
+	ticks = (unsigned long long)(samples[n - 1].ts - samples[0].ts) * IRRI_TICKS;
+	for (i = 0; i < PROFILE_BANDS; i++) {
+		if (config.pulse_on[i] * PULSE_UNIT > max_on) {
+			max_on = config.pulse_on[i] * PULSE_UNIT;
+		}
+	}
+
+	start = clock();
+	for (tick = 0; tick < ticks; tick++) {
+		if (key_period && tick % key_period == key_period / 2) {
+			display_count = KEY_TICKS;
+		}
+		/*
+		 * energy of this tick by measurement phase before the reading
+		 */
+		charge[E_CPU] += I_CPU_IDLE * TICK_US + (I_CPU_ACTIVE - I_CPU_IDLE) * T_TICK;
+		charge[E_DISPLAY] += I_DISPLAY_OFF * TICK_US;
+		if (measure_count < precharge) {
+			charge[E_SENSOR] += I_PRECHARGE * TICK_US;
+		} else if (measure_count < sample_tick) {
+			converting = cvt * 10000ULL - (measure_count - precharge) * TICK_US;
+			charge[E_SENSOR] += I_CONVERT * (converting < TICK_US ? converting : TICK_US);
+			if (precharge == 0 && measure_count > 0) {
+				charge[E_CPU] += (I_CPU_ACTIVE - I_CPU_IDLE) * T_POLL;
+			}
+		}
+		if (measure_count < sample_tick) {	// colon on while measuring
+			charge[E_DISPLAY] += (unsigned long long)SEGMENTS_COLON * I_SEGMENT * duty[brightness] / 16 * TICK_US;
+		}
+		if (display_count > 0) {
+			display_count--;
+			charge[E_DISPLAY] += (unsigned long long)SEGMENTS_TEMP * I_SEGMENT * duty[brightness] / 16 * TICK_US;
+		}
+		if (measure_count == sample_tick) {
+			ts = samples[0].ts + (long)(tick / IRRI_TICKS);
+			while (samples[idx + 1].ts < ts) {
+				idx++;
+			}
+			temp = samples[idx].temp + (samples[idx + 1].temp - samples[idx].temp)
+				* (ts - samples[idx].ts) / (samples[idx + 1].ts - samples[idx].ts);
+			if (noise > 0) {
+				seed ^= seed << 13;		// xorshift32
+				seed ^= seed >> 17;
+				seed ^= seed << 5;
+				temp += noise * ((seed % 2001) / 1000.0 - 1);
+			}
+			t = (int8_t)lround(temp * 2);
+			readings++;
+			charge[E_CPU] += (I_CPU_ACTIVE - I_CPU_IDLE) * T_SENSOR;
+			on = irri.irri_mode;
+			measure_period = irri_sample(&irri, t, (uint16_t)ts);
+			if (on > 0 && irri.irri_mode == 0) {
+				ee_bytes += EE_SAVE;
+			}
+			if (irri.irri_mode > 0 && t < min_protected) {
+				min_protected = t;
+			}
+			if (irri.irri_mode == 0 && t <= config.low && t < min_unprotected) {
+				min_unprotected = t;
+			}
+			if (irri_log(&irri.cfg, irri.filtered, irri.irri_mode, last_temp, last_mode)) {
+				last_temp = irri.filtered;
+				last_mode = irri.irri_mode;
+				irri.flt_writes++;
+				events++;
+				ee_bytes += EE_EVENT;
+				if (verbose) {
+					printf("%s event %.1f mode %u", ts_string(ts, 0), last_temp / 2.0, last_mode);
+					if (irri.eta > 0) {
+						printf(" predicted crossing %u[min]", irri.eta);
+					}
+					printf("\n");
+				}
+			}
+		}
+		if (++measure_count >= measure_period) {
+			measure_count = 0;
+		}
+		on = irri_pulse(&irri);
+		if (on != relay) {
+			relay = on;
+			switches += on;
+			if (verbose) {
+				printf("%s relay %s\n", ts_string(samples[0].ts + (long)(tick / IRRI_TICKS), tick % IRRI_TICKS), on ? "on" : "off");
+			}
+		}
+		on_ticks += relay;
+		if (relay) {
+			charge[E_RELAY] += I_RELAY * TICK_US;
+		}
+		/*
+		 * pulse check: on phase ends within the longest on phase after a
+		 * mode change
+		 */
+		if (irri.irri_mode != pulse_mode) {
+			pulse_mode = irri.irri_mode;
+			on_run = 0;
+		}
+		on_run = relay ? on_run + 1 : 0;
+		if (   on_run == max_on + 2 && pulse_mode > 0
+			&& config.pulse_off[(pulse_mode > PROFILE_BANDS ? PROFILE_BANDS : pulse_mode) - 1] != 0) {
+			pulse_errors++;
+			if (verbose) {
+				printf("%s relay on longer than the on phase\n", ts_string(samples[0].ts + (long)(tick / IRRI_TICKS), tick % IRRI_TICKS));
+			}
+		}
+		if (tick % 36000 == 35999) {
+			ee_bytes += EE_HISTO;
+		}
+	}
+	charge[E_EEPROM] = (unsigned long long)ee_bytes * I_EEPROM * T_EEPROM;
+
+	printf("%s: %s - ", name, ts_string(samples[0].ts, 0));
+	printf("%s, %llu ticks (%.1f Mticks/s)\n", ts_string(samples[n - 1].ts, 0), ticks,
+		ticks / 1e6 / ((double)(clock() - start) / CLOCKS_PER_SEC + 1e-9));
+	printf("  readings %lu, relay switches %lu, water on %s (%.2f%%)\n", readings, switches,
+		hms(on_ticks / IRRI_TICKS), ticks ? 100.0 * on_ticks / ticks : 0.0);
+	if (pulse_errors > 0) {
+		printf("  pulse check failed: relay on longer than the on phase %lu times\n", pulse_errors);
+	}
+	if (min_protected < 127) {
+		printf("  min temperature irrigating %.1f", min_protected / 2.0);
+	} else {
+		printf("  no irrigation");
+	}
+	if (min_unprotected < 127) {
+		printf(", min temperature at/below low threshold not irrigating %.1f", min_unprotected / 2.0);
+	}
+	printf("\n  eeprom events %lu, unfiltered %u, saved by filter %d\n",
+		events, irri.flt_raw, (int)irri.flt_raw - (int)irri.flt_writes);
+
+	days = ticks / 864000.0;
+	printf("  energy [uAh/day]");
+	for (i = 0; i < E_COUNT; i++) {
+		printf("%s %s %.1f", i ? "," : ":", e_names[i], charge[i] / 3.6e9 / days);
+		total += charge[i] / 3.6e9 / days;
+	}
+	printf(", total %.1f (average %.1f[uA])\n", total, total / 24);
+	if (budget > 0 && total > budget) {
+		printf("  energy budget %.1f[uAh/day] exceeded\n", budget);
+		return 1;
+	}
+	return pulse_errors > 0;
+}
+
+static void usage()
+{
+	fprintf(stderr, "usage: replay [-H high] [-L low] [-l lead] [-i min,max] [-r mode,on,off]...\n"
+		"              [-b brightness] [-k keys] [-B budget] [-n noise] [-f family]\n"
+		"              [-x] [-v] file.csv...\n");
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	sample_t *samples = NULL;
+	size_t n;
+	int opt, i, mode, on, off, min, max, rc = 0;
+
+	for (i = 0; i < PROFILE_BANDS; i++) {	// 60[s] on / (n - 1) x 30[s] off
+		config.pulse_on[i] = 60 * IRRI_TICKS / PULSE_UNIT;
+		config.pulse_off[i] = i * 30 * IRRI_TICKS / PULSE_UNIT;
+	}
+	while ((opt = getopt(argc, argv, "H:L:l:i:r:b:k:B:n:f:xv")) != -1) {
+		switch (opt) {
+			case 'H':
+				config.high = (int8_t)lround(atof(optarg) * 2);
+				break;
+			case 'L':
+				config.low = (int8_t)lround(atof(optarg) * 2);
+				break;
+			case 'l':
+				config.lead = (uint8_t)atoi(optarg);
+				break;
+			case 'i':
+				if (sscanf(optarg, "%d,%d", &min, &max) != 2 || min < 2 || min > max || max > CACHE_MAX_AGE) {
+					usage();
+				}
+				config.interval_min = (uint8_t)min;
+				config.interval_max = (uint8_t)max;
+				break;
+			case 'r':
+				if (   sscanf(optarg, "%d,%d,%d", &mode, &on, &off) != 3
+					|| mode < 1 || mode > PROFILE_BANDS || on < 10 || on > 2550 || off < 0 || off > 2550) {
+					usage();
+				}
+				config.pulse_on[mode - 1] = (uint8_t)(on / 10);
+				config.pulse_off[mode - 1] = (uint8_t)(off / 10);
+				break;
+			case 'b':
+				brightness = (unsigned)atoi(optarg);
+				if (brightness >= sizeof(duty)) {
+					usage();
+				}
+				break;
+			case 'k':
+				keys_per_day = (unsigned)atoi(optarg);
+				break;
+			case 'B':
+				budget = atof(optarg);
+				break;
+			case 'n':
+				noise = atof(optarg);
+				break;
+			case 'f':
+				if (strcmp(optarg, "s20") == 0) {
+					cvt = DS18x20_CVT_S20;
+				} else if (strcmp(optarg, "b20") == 0) {
+					cvt = DS18x20_CVT_B20;
+				} else {
+					usage();
+				}
+				break;
+			case 'x':
+				precharge = 0;
+				break;
+			case 'v':
+				verbose = 1;
+				break;
+			default:
+				usage();
+		}
+	}
+	if (optind >= argc || config.low > config.high) {
+		usage();
+	}
+	for (i = optind; i < argc; i++) {
+		n = read_csv(argv[i], &samples);
+		if (n >= 2) {
+			rc |= replay(argv[i], samples, n);
+		} else {
+			fprintf(stderr, "%s: less than 2 samples\n", argv[i]);
+		}
+		free(samples);
+	}
+	return rc;
+}
@@ -0,0 +1,28 @@
+/*
+ * avr/eeprom.h - host simulation (tools/stress.c)
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ *
+ * eeprom data is a plain variable, written bytes are counted (sim.c)
+ */
+#ifndef SIM_AVR_EEPROM_H_
+#define SIM_AVR_EEPROM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <avr/io.h>
+
+#define EEMEM
+#define eeprom_busy_wait()
+
+void eeprom_read_block(void *dst, const void *src, size_t n);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+uint8_t eeprom_read_byte(const uint8_t *p);
+void eeprom_update_byte(uint8_t *p, uint8_t value);
+void eeprom_write_byte(uint8_t *p, uint8_t value);
+uint16_t eeprom_read_word(const uint16_t *p);
+void eeprom_update_word(uint16_t *p, uint16_t value);
+
+#endif /* SIM_AVR_EEPROM_H_ */
@@ -0,0 +1,17 @@
+/*
+ * avr/interrupt.h - host simulation (tools/stress.c)
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ *
+ * the harness calls the ISR functions each simulated tick
+ */
+#ifndef SIM_AVR_INTERRUPT_H_
+#define SIM_AVR_INTERRUPT_H_
+
+#define ISR(vector)	void vector(void)
+#define sei()
+#define cli()
+
+#endif /* SIM_AVR_INTERRUPT_H_ */
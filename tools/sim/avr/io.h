@@ -0,0 +1,61 @@
+/*
+ * avr/io.h - host simulation (tools/stress.c, tools/replay.c)
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ *
+ * ATtiny85 registers used by the firmware as plain variables (sim.c),
+ * the firmware main() is renamed to firmware_main(), the naked .init3
+ * function is a plain function called by sim_boot()
+ */
+#ifndef SIM_AVR_IO_H_
+#define SIM_AVR_IO_H_
+
+#include <stdint.h>
+
+extern volatile uint8_t PORTB, DDRB, PINB, TCCR0A, TCCR0B, OCR0A, TIMSK, TIFR, TCNT0, OSCCAL, MCUSR, ADMUX, ADCSRA;
+extern volatile uint16_t ADC;
+
+#ifndef SIM_HARNESS
+#define main	firmware_main
+#define naked	noinline
+#endif
+
+#define _BV(bit)	(1U << (bit))
+#define bit_is_set(reg, bit)	((reg) & _BV(bit))
+#define bit_is_clear(reg, bit)	(!((reg) & _BV(bit)))
+#define loop_until_bit_is_clear(reg, bit)	do { } while (bit_is_set(reg, bit))
+
+#define PB0		0
+#define PB1		1
+#define PB2		2
+#define PB3		3
+#define PB4		4
+#define PB5		5
+#define DDB2	2
+
+#define WGM01	1
+#define CS00	0
+#define CS02	2
+#define OCIE0A	4
+#define OCF0A	4
+
+#define PORF	0
+#define EXTRF	1
+#define BORF	2
+#define WDRF	3
+
+#define MUX0	0
+#define MUX1	1
+#define MUX2	2
+#define MUX3	3
+#define ADPS0	0
+#define ADPS1	1
+#define ADPS2	2
+#define ADSC	6
+#define ADEN	7
+
+#define E2END	511
+
+#endif /* SIM_AVR_IO_H_ */
@@ -0,0 +1,19 @@
+/*
+ * avr/pgmspace.h - host simulation (tools/stress.c)
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ */
+#ifndef SIM_AVR_PGMSPACE_H_
+#define SIM_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+
+#define PROGMEM
+#define PSTR(s)				(s)
+#define pgm_read_byte(p)	(*(const uint8_t *)(p))
+#define pgm_read_word(p)	(*(const uint16_t *)(p))
+#define pgm_read_ptr(p)		(*(void * const *)(p))
+
+#endif /* SIM_AVR_PGMSPACE_H_ */
@@ -0,0 +1,20 @@
+/*
+ * avr/sleep.h - host simulation (tools/stress.c)
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ *
+ * sleep_cpu() returns from the firmware main() to the harness (sim.c)
+ */
+#ifndef SIM_AVR_SLEEP_H_
+#define SIM_AVR_SLEEP_H_
+
+#define SLEEP_MODE_IDLE	0
+#define set_sleep_mode(mode)
+#define sleep_enable()
+#define sleep_cpu()	sim_sleep()
+
+void sim_sleep(void);
+
+#endif /* SIM_AVR_SLEEP_H_ */
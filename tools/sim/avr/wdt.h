@@ -0,0 +1,25 @@
+/*
+ * avr/wdt.h - host simulation (tools/stress.c)
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ *
+ * watchdog resets are checked against the enabled timeout (sim.c)
+ */
+#ifndef SIM_AVR_WDT_H_
+#define SIM_AVR_WDT_H_
+
+#include <stdint.h>
+
+#define WDTO_1S	6
+#define WDTO_2S	7
+
+#define wdt_enable(timeout)	sim_wdt_enable(timeout)
+#define wdt_disable()		sim_wdt_enable(0xFF)
+#define wdt_reset()			sim_wdt_reset()
+
+void sim_wdt_enable(uint8_t timeout);
+void sim_wdt_reset(void);
+
+#endif /* SIM_AVR_WDT_H_ */
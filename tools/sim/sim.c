@@ -0,0 +1,382 @@
+/*
+ * sim.c
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ *
+ * simulated peripherals of the host harness, see sim.h
+ */
+#define SIM_HARNESS
+#include <stdint.h>
+#include <string.h>
+#include <setjmp.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include <util/delay.h>
+#include "sim.h"
+#include "ds18x20.h"
+#include "tm1637.h"
+#include "uart.h"
+#include "vcc.h"
+#include "frostguard.h"
+#include "globals.h"
+
+sim_t sim = {
+	.key = KEY_NONE,
+	.temp = BINTEMP(5),
+	.parasite = 1,
+	.vcc = VCC(4.8),
+	.osccal = 0x80
+};
+
+volatile uint8_t PORTB, DDRB, PINB, TCCR0A, TCCR0B, OCR0A, TIMSK, TIFR, TCNT0, OSCCAL, MCUSR, ADMUX, ADCSRA;
+volatile uint16_t ADC;
+
+static jmp_buf boot;
+
+int firmware_main(void);
+void mcusr_save(void);
+
+/**
+ * add duration of a driver call, delay or eeprom write
+ */
+void sim_cost(uint32_t us)
+{
+	sim.work += us;
+	sim.now += us;
+}
+
+/**
+ * run firmware main() until it goes to sleep
+ */
+void sim_boot(uint8_t mcusr)
+{
+	MCUSR = mcusr;
+	OSCCAL = SIM_OSCCAL;
+	sim.wdt_timeout = 0;
+	if (setjmp(boot) == 0) {
+		mcusr_save();
+		firmware_main();
+	}
+}
+
+void sim_sleep(void)
+{
+	longjmp(boot, 1);
+}
+
+/**
+ * start of tick: the timer interrupt fires every SIM_TICK_US or right
+ * after a longer ISR
+ */
+void sim_tick(uint64_t tick)
+{
+	if (sim.now < tick * SIM_TICK_US) {
+		sim.now = tick * SIM_TICK_US;
+	}
+	sim.work = 0;
+	sim.serial = 0;
+	sim_cost(SIM_T_TICK);
+}
+
+/**
+ * main loop until the next tick: eeprom writes deferred by the tick ISR
+ * (ee_flush()), not counted as tick work
+ */
+void sim_idle(uint64_t tick)
+{
+	register uint32_t work = sim.work;
+
+	while (sim.now + SIM_T_EEPROM <= tick * SIM_TICK_US && ee_flush()) {
+	}
+	sim.work = work;
+}
+
+/**
+ * watchdog
+ */
+void sim_wdt_enable(uint8_t timeout)
+{
+	sim.wdt_timeout = timeout == WDTO_2S ? SIM_WDT_US : (timeout == WDTO_1S ? SIM_WDT_US / 2 : 0);
+	sim.wdt_last = sim.now;
+}
+
+void sim_wdt_reset(void)
+{
+	if (sim.wdt_timeout != 0 && sim.now - sim.wdt_last > sim.wdt_max) {
+		sim.wdt_max = (uint32_t)(sim.now - sim.wdt_last);
+	}
+	sim.wdt_last = sim.now;
+}
+
+/**
+ * delays
+ */
+void _delay_us(double us)
+{
+	sim_cost((uint32_t)us);
+}
+
+void _delay_ms(double ms)
+{
+	sim_cost((uint32_t)(ms * 1000));
+}
+
+/**
+ * eeprom, only changed bytes are written (counted separately in the
+ * supply voltage safe state)
+ */
+void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+	memcpy(dst, src, n);
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+
+	while (n-- > 0) {
+		if (*d != *s) {
+			*d = *s;
+			sim.ee_bytes++;
+			if (globals.vcc_safe) {
+				sim.ee_safe++;
+			}
+			sim_cost(SIM_T_EEPROM);
+		}
+		d++;
+		s++;
+	}
+}
+
+uint8_t eeprom_read_byte(const uint8_t *p)
+{
+	return *p;
+}
+
+void eeprom_update_byte(uint8_t *p, uint8_t value)
+{
+	eeprom_update_block(&value, p, 1);
+}
+
+void eeprom_write_byte(uint8_t *p, uint8_t value)
+{
+	*p = value;
+	sim.ee_bytes++;
+	if (globals.vcc_safe && !(ee_pending & EE_CLOSE)) {
+		sim.ee_safe++;
+	}
+	sim_cost(SIM_T_EEPROM);
+}
+
+uint16_t eeprom_read_word(const uint16_t *p)
+{
+	return *p;
+}
+
+void eeprom_update_word(uint16_t *p, uint16_t value)
+{
+	eeprom_update_block(&value, p, 2);
+}
+
+/**
+ * TM1637 display and keys
+ */
+void TM1637_init(const uint8_t enable, const uint8_t brightness)
+{
+	(void)enable;
+	(void)brightness;
+	sim_cost(2 * SIM_T_DISPLAY);
+}
+
+void TM1637_enable(const uint8_t value)
+{
+	(void)value;
+	sim_cost(SIM_T_DISPLAY);
+}
+
+void TM1637_set_brightness(const uint8_t value)
+{
+	(void)value;
+	sim_cost(SIM_T_DISPLAY);
+}
+
+void TM1637_display_segments(const uint8_t position, const uint8_t segments)
+{
+	(void)position;
+	(void)segments;
+	sim_cost(SIM_T_DISPLAY);
+}
+
+void TM1637_display_digit(const uint8_t position, const uint8_t digit)
+{
+	(void)position;
+	(void)digit;
+	sim_cost(SIM_T_DISPLAY);
+}
+
+void TM1637_display_msg(const uint8_t *msg)
+{
+	(void)msg;
+	sim_cost(TM1637_POSITION_MAX * SIM_T_DISPLAY);
+}
+
+void TM1637_display_msg_P(const uint8_t *msg)
+{
+	TM1637_display_msg(msg);
+}
+
+void TM1637_display_colon(const uint8_t value)
+{
+	(void)value;
+	sim_cost(SIM_T_DISPLAY);
+}
+
+void TM1637_clear(void)
+{
+	sim_cost(TM1637_POSITION_MAX * SIM_T_DISPLAY);
+}
+
+uint8_t TM1637_keyscan()
+{
+	sim_cost(SIM_T_KEYSCAN);
+	return sim.key;
+}
+
+/**
+ * DS18x20 sensor (DS18S20), a fault applies to the next reading
+ */
+uint8_t DS18x20_parasite = 1;
+uint8_t DS18x20_family = DS18x20_FAMILY_S20;
+uint8_t DS18x20_cvt = DS18x20_CVT_S20;
+
+uint8_t DS18x20_rdpower()
+{
+	_delay_ms(200);
+	sim_cost(SIM_T_RESET + 2 * SIM_T_OW_BYTE);
+	DS18x20_parasite = sim.parasite;
+	return DS18x20_parasite;
+}
+
+uint8_t DS18x20_readrom()
+{
+	sim_cost(SIM_T_RESET + 9 * SIM_T_OW_BYTE);
+	return DS18x20_family;
+}
+
+int16_t DS18x20_startcv()
+{
+	sim_cost(SIM_T_RESET);
+	if (sim.fault == SIM_NO_RESET) {
+		sim.fault = SIM_OK;
+		return DS18x20_NO_RESET;
+	}
+	sim_cost(2 * SIM_T_OW_BYTE);
+	return DS18x20_NO_VALUE;
+}
+
+uint8_t DS18x20_readbit()
+{
+	sim_cost(SIM_T_OW_BYTE / 8);
+	return 1;
+}
+
+int16_t DS18x20_readtemp()
+{
+	register uint8_t fault = sim.fault;
+
+	sim_cost(SIM_T_RESET + 11 * SIM_T_OW_BYTE);
+	sim.fault = SIM_OK;
+	if (fault == SIM_NO_RESET) {
+		return DS18x20_NO_RESET;
+	}
+	if (fault == SIM_NO_DATA) {
+		return DS18x20_NO_DATA;
+	}
+	return fault == SIM_RANGE ? BINTEMP(85) : sim.temp;
+}
+
+int16_t DS18x20_gettemp()
+{
+	register int16_t temp = DS18x20_startcv();
+
+	if (temp == DS18x20_NO_RESET) {
+		return temp;
+	}
+	_delay_ms(DS18x20_cvt * 10);
+	return DS18x20_readtemp();
+}
+
+/**
+ * uart, a command line is received once
+ */
+void uart_tx(char data)
+{
+	sim.tx_bytes++;
+	if (data == '>') {
+		sim.prompts++;
+	}
+	sim.serial += SIM_T_UART;
+	sim_cost(SIM_T_UART);
+}
+
+void uart_tx_string(char *s)
+{
+	while (*s) {
+		uart_tx(*s++);
+	}
+}
+
+void uart_tx_string_P(const char *s)
+{
+	while (*s) {
+		uart_tx(*s++);
+	}
+}
+
+int16_t uart_rx(uint16_t timeout)
+{
+	sim.serial += (uint32_t)timeout * SIM_T_POLL;
+	sim_cost((uint32_t)timeout * SIM_T_POLL);
+	return UART_RX_NONE;
+}
+
+uint8_t uart_rx_line(char *buf, uint8_t size, uint16_t timeout)
+{
+	register uint8_t n;
+
+	if (sim.line == NULL) {
+		sim.serial += (uint32_t)timeout * SIM_T_POLL;
+		sim_cost((uint32_t)timeout * SIM_T_POLL);
+		return 0;
+	}
+	strncpy(buf, sim.line, size - 1);
+	buf[size - 1] = 0;
+	n = (uint8_t)strlen(buf);
+	sim.serial += (n + 1) * SIM_T_UART;
+	sim_cost((n + 1) * SIM_T_UART);
+	sim.line = NULL;
+	return n;
+}
+
+int16_t uart_calibrate()
+{
+	sim.serial += 100000UL;	// host sends 'U'
+	_delay_ms(100);
+	OSCCAL = sim.osccal;
+	return sim.osccal;
+}
+
+/**
+ * supply voltage
+ */
+uint8_t vcc_read()
+{
+	sim_cost(SIM_T_ADC);
+	VCC_STOP();
+	return sim.vcc;
+}
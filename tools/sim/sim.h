@@ -0,0 +1,78 @@
+/*
+ * sim.h
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ *
+ * simulated peripherals of the host harness (tools/stress.c): registers,
+ * eeprom, TM1637 display / keys, DS18x20 sensor, uart and supply voltage
+ *
+ * the drivers tm1637.c, ds18x20.c, uart.c and vcc.c are replaced by
+ * sim.c, all other firmware sources are linked unchanged. Each driver
+ * call, delay and eeprom byte written adds its estimated duration to the
+ * simulated work of the current tick; the eeprom writes deferred to the
+ * main loop take the time left until the next tick (sim_idle()).
+ */
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdint.h>
+#include <avr/io.h>
+
+/**
+ * estimated durations [us] at 1[MHz]
+ */
+#define SIM_T_TICK		1500	// tick ISR without driver calls
+#define SIM_T_DISPLAY	700		// TM1637 command (bit banged, 5[us] delays)
+#define SIM_T_KEYSCAN	500
+#define SIM_T_RESET		960		// 1-wire reset
+#define SIM_T_OW_BYTE	560		// 1-wire byte
+#define SIM_T_UART		521		// uart character 19200 Baud
+#define SIM_T_EEPROM	3400	// eeprom byte write
+#define SIM_T_ADC		200		// supply voltage reading
+#define SIM_T_POLL		10		// uart rx poll loop
+
+#define SIM_TICK_US		100000UL
+#define SIM_WDT_US		2000000UL	// WDTO_2S (0xFF = off)
+#define SIM_OSCCAL		0x80		// factory OSCCAL value, loaded at reset
+
+/**
+ * sensor faults of the next reading
+ */
+#define SIM_OK			0
+#define SIM_NO_RESET	1	// no presence pulse
+#define SIM_NO_DATA		2	// scratchpad crc error
+#define SIM_RANGE		3	// power on value 85[]
+
+typedef struct
+{
+	uint8_t		key;		// TM1637_keyscan() value (KEY_NONE, KEY_UP, ...)
+	int16_t		temp;		// binary temperature of the sensor
+	uint8_t		fault;		// fault of the next reading SIM_xxx
+	uint8_t		parasite;	// sensor parasite powered
+	uint8_t		vcc;		// supply voltage [VCC_UNIT]
+	uint8_t		osccal;		// calibration result of uart_calibrate()
+	const char	*line;		// next serial command line, NULL = none
+
+	uint64_t	now;		// simulated time [us]
+	uint32_t	work;		// work of the current tick [us]
+	uint32_t	serial;		// uart transfer time of the current tick [us], part of work
+	uint32_t	wdt_timeout;	// watchdog timeout [us], 0 = off
+	uint64_t	wdt_last;	// time of the last watchdog reset [us]
+	uint32_t	wdt_max;	// max time between watchdog resets [us]
+	uint64_t	ee_bytes;	// eeprom bytes written
+	uint64_t	ee_safe;	// eeprom bytes written in the supply voltage safe state
+	uint64_t	tx_bytes;	// uart characters sent
+	uint64_t	prompts;	// serial command prompts '>' sent
+
+} sim_t;
+
+extern sim_t sim;
+
+void sim_boot(uint8_t mcusr);
+void sim_tick(uint64_t tick);
+void sim_idle(uint64_t tick);
+void sim_cost(uint32_t us);
+
+#endif /* SIM_H_ */
@@ -0,0 +1,37 @@
+/*
+ * util/crc16.h - host simulation (tools/stress.c)
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ *
+ * C equivalents of the avr-libc crc functions
+ */
+#ifndef SIM_UTIL_CRC16_H_
+#define SIM_UTIL_CRC16_H_
+
+#include <stdint.h>
+
+static inline uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data)
+{
+	uint8_t i;
+
+	crc ^= data;
+	for (i = 0; i < 8; i++) {
+		crc = crc & 0x80 ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	}
+	return crc;
+}
+
+static inline uint8_t _crc_ibutton_update(uint8_t crc, uint8_t data)
+{
+	uint8_t i;
+
+	crc ^= data;
+	for (i = 0; i < 8; i++) {
+		crc = crc & 0x01 ? (crc >> 1) ^ 0x8C : crc >> 1;
+	}
+	return crc;
+}
+
+#endif /* SIM_UTIL_CRC16_H_ */
@@ -0,0 +1,16 @@
+/*
+ * util/delay.h - host simulation (tools/stress.c)
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ *
+ * delays are added to the simulated work of the tick (sim.c)
+ */
+#ifndef SIM_UTIL_DELAY_H_
+#define SIM_UTIL_DELAY_H_
+
+void _delay_us(double us);
+void _delay_ms(double ms);
+
+#endif /* SIM_UTIL_DELAY_H_ */
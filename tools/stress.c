@@ -0,0 +1,504 @@
+/*
+ * stress.c
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ *
+ * host tool: randomized key sequences through the tick ISR and the mode
+ * functions of the firmware, linked against simulated peripherals (sim/)
+ *
+ *   gcc -O2 -Wall -DCHECK_INVARIANTS=0 -Isim -I.. -o stress stress.c sim/sim.c
+ *       ../frostguard.c ../globals.c ../mode_watch.c ../mode_table.c
+ *       ../mode_datetime.c ../mode_irrigate.c ../mode_data.c ../mode_temp.c
+ *       ../irrigation.c ../trace.c
+ *
+ *   stress [-n sequences] [-s seed] [-t ms] [-x] [-v]
+ *
+ *   -n         key sequences (default 10000)
+ *   -s         seed of the random numbers (default 1)
+ *   -t         tick work budget [ms] (default 100, the tick), exit code 1
+ *              if a tick works longer (0 = no budget); in MODE_DATA the
+ *              uart transfer time is not counted (the bit banged export
+ *              and command answers hold the tick by design)
+ *   -x         externally powered sensor
+ *   -v         print each failure
+ *
+ * The firmware boots into MODE_RESET with the initial eeprom data. Each
+ * sequence is a random series of key actions: hits, long holds (KEY_xxx_L
+ * in every mode and submode, auto-repeat in the setting modes), key
+ * changes without release and pauses. Some sequences start with the menu
+ * selection of a mode, some are followed by a long watch mode run or a
+ * frost night (temperature jumping around the thresholds for hours, more
+ * events than the event memory holds). Sensor
+ * faults, supply voltage dips, serial commands in MODE_DATA (with their
+ * eeprom writes) and warm restarts after a watchdog reset are injected at
+ * random. CHECK_INVARIANTS 0 keeps the repairs of the firmware from hiding
+ * a violation.
+ *
+ * checked after each tick:
+ *
+ * - mode within MODE_RESET...MODE_DATA
+ * - relay off outside MODE_WATCH / MODE_IRRIG
+ * - params within the bounds of watch mode (MODE_WATCH)
+ * - no eeprom write in the supply voltage safe state
+ * - event ring only appended at the newest and dropped at the oldest
+ *   event, day index within the events, each event to log is written
+ *   (also on full event memory)
+ * - trace of the run before a warm restart frozen (also if the restart
+ *   hit the safe state)
+ * - clock kept over a warm restart
+ * - watchdog reset within WDT_TIMEOUT
+ *
+ * and after each sequence: KEY_SET (MODE_RESET) or KEY_SET_L reach the
+ * watch mode within ESCAPE_TICKS (no stuck submode).
+ *
+ * The host compiler pads the eeprom structures, so the simulated eeprom
+ * holds fewer events than the device (drops happen more often).
+ *
+ * The work of each tick is estimated from the driver calls, delays and
+ * eeprom bytes written (sim.h); the worst case is reported per mode with
+ * the submode it was seen in, a tick over the budget (-t) fails. Exit
+ * code 1 on any failure.
+ */
+#define SIM_HARNESS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim.h"
+#include "ds18x20.h"
+#include "frostguard.h"
+#include "globals.h"
+#include "trace.h"
+#include "vcc.h"
+
+#define ESCAPE_TICKS	100		// ticks to reach watch mode
+#define MAX_FAILURES	10		// failures printed (without -v)
+#define WATCH_RUN		36000	// max ticks of a watch mode run (1[h])
+
+void TIM0_COMPA_vect(void);
+
+static const char *mode_names[] = { "reset", "temps", "datime", "watch", "menu", "irrig", "bright", "data" };
+static const uint8_t key_codes[] = { KEY_UP, KEY_DOWN, KEY_SET };
+
+/**
+ * serial command lines, '#' is replaced by a random number
+ */
+static const char *lines[] = {
+	"t", "p3.0,1.0,5", "p#,#,#", "p1.0,3.0,5", "c#", "l#", "i10,120", "i#,#", "i2,255",
+	"r#,60,30", "r#,#,#", "o", "d", "d#", "n", "x", "h-3.0", "h#", "v2900", "v#",
+	"s1", "s0", "u#", "f#", "q", "", "?", "p", "i,", "d999999999999"
+};
+
+static uint32_t seed = 1;
+static int verbose = 0;
+static unsigned gate = SIM_TICK_US / 1000;	// [ms], 0 = none
+static uint64_t tick = 0;
+static unsigned long failures = 0;
+static unsigned sequence;
+#if TRACE_DEPTH > 0
+static uint8_t freeze_due = 0;	// trace to be frozen after a warm restart
+#endif
+
+static struct
+{
+	uint32_t	work;		// worst-case tick work [us]
+	uint8_t		submode;	// submode at the start of the worst-case tick
+	uint64_t	ticks;
+	uint64_t	over;		// ticks longer than the tick
+
+} stats[MODE_DATA + 1];
+
+/**
+ * xorshift32
+ */
+static uint32_t rnd(uint32_t n)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return n > 0 ? seed % n : 0;
+}
+
+static void fail(const char *what)
+{
+	if (verbose || failures < MAX_FAILURES) {
+		printf("FAIL seq %u tick %llu mode %u submode %u key %02X: %s\n", sequence,
+			(unsigned long long)tick, globals.mode, globals.submode, sim.key, what);
+	}
+	failures++;
+}
+
+/**
+ * random serial command line
+ */
+static const char *random_line()
+{
+	static char buffer[24];
+	register const char *s = lines[rnd(sizeof(lines) / sizeof(lines[0]))];
+	register char *d = buffer;
+
+	while (*s && d < buffer + sizeof(buffer) - 12) {
+		if (*s == '#') {
+			d += sprintf(d, rnd(2) ? "%u" : "%u.5", rnd(4) == 0 ? rnd(0x10000) : rnd(12));
+		} else {
+			*d++ = *s;
+		}
+		s++;
+	}
+	*d = 0;
+	return buffer;
+}
+
+/**
+ * sensor, supply voltage and serial line of the next tick
+ */
+static void inject()
+{
+	if (rnd(50) == 0) {		// temperature random walk -4.0...8.0[]
+		sim.temp += rnd(2) ? 1 : -1;
+		if (sim.temp < BINTEMP(-4)) {
+			sim.temp = BINTEMP(-4);
+		} else if (sim.temp > BINTEMP(8)) {
+			sim.temp = BINTEMP(8);
+		}
+	}
+	if (rnd(200) == 0) {
+		sim.fault = 1 + rnd(3);
+	}
+	if (sim.vcc < VCC(4.8)) {
+		if (rnd(300) == 0) {
+			sim.vcc = VCC(4.8);
+		}
+	} else if (rnd(5000) == 0) {
+		sim.vcc = VCC(2.4) + rnd(VCC(0.8));
+	}
+	if (globals.mode == MODE_DATA && rnd(8) == 0) {
+		sim.line = random_line();
+	}
+	sim.osccal = rnd(2) == 0 ? rnd(0x100) : SIM_OSCCAL - 2 * OSCCAL_RANGE + rnd(4 * OSCCAL_RANGE);
+}
+
+/**
+ * event ring: events are only appended behind the newest (at most 2 per
+ * tick) and dropped from the oldest, the day index points into the events
+ */
+static event_t shadow[MAX_EVENTS];
+static int8_t shadow_n = 0;				// -1 = take the ring as it is
+
+static void check_events()
+{
+	event_t events[MAX_EVENTS];
+	register int8_t n = globals.params.write;
+	register int8_t i, keep;
+
+	for (i = 0; i < n && i < (int8_t)MAX_EVENTS; i++) {
+		events[i] = eedata.events[(globals.params.head + i) % MAX_EVENTS];
+	}
+	for (keep = n < shadow_n ? n : shadow_n; keep > 0; keep--) {
+		if (memcmp(events, shadow + shadow_n - keep, keep * sizeof(event_t)) == 0) {
+			break;
+		}
+	}
+	if (n - keep > 2 && shadow_n >= 0) {
+		fail("event ring corrupted");
+	}
+	memcpy(shadow, events, n * sizeof(event_t));
+	shadow_n = n;
+	for (i = 0; i < DAY_INDEX && globals.days[i].day != DAY_UNSET; i++) {
+		if (globals.days[i].first >= n) {
+			fail("day index beyond the events");
+			break;
+		}
+	}
+}
+
+/**
+ * one tick: ISR, work and invariants
+ */
+static void run_tick(uint8_t key)
+{
+	static uint64_t data_prompts;
+	static unsigned data_ticks;
+	register uint16_t flt_writes = irri.flt_writes;
+	event_t newest;
+	register uint8_t mode = globals.mode <= MODE_DATA ? globals.mode : MODE_WATCH;
+	register uint8_t submode = globals.submode;
+	register params_t *p = &globals.params;
+
+	inject();
+	sim.key = key;
+	sim_tick(tick);
+	TIM0_COMPA_vect();
+	tick++;
+
+	stats[mode].ticks++;
+	if (sim.work > stats[mode].work) {
+		stats[mode].work = sim.work;
+		stats[mode].submode = submode;
+	}
+	if (sim.work > SIM_TICK_US) {
+		stats[mode].over++;
+	}
+	if (gate > 0 && (mode == MODE_DATA ? sim.work - sim.serial : sim.work) > gate * 1000UL) {
+		fail("tick work over gate");
+	}
+	sim_idle(tick);
+
+	if (globals.mode > MODE_DATA) {
+		fail("mode out of range");
+	}
+	if (IRRI_IS_ON() && globals.mode != MODE_WATCH && globals.mode != MODE_IRRIG) {
+		fail("relay on outside watch / irrigate");
+	}
+	if (   globals.mode == MODE_WATCH
+		&& (   p->temperatures.low < 0 || p->temperatures.low > p->temperatures.high
+			|| p->temperatures.high > BINTEMP(10)
+			|| p->brightness > MAX_BRIGHTNESS
+			|| p->interval_min < 2 || p->interval_min > p->interval_max
+			|| p->interval_max > CACHE_MAX_AGE
+			|| p->fail_policy > FAIL_STOP || p->telemetry > 1
+			|| p->write < 0 || p->write > (int8_t)MAX_EVENTS
+			|| p->exported < 0 || p->exported > p->write
+			|| p->head >= MAX_EVENTS)) {
+		fail("params out of bounds");
+	}
+	if ((uint8_t)(OSCCAL - SIM_OSCCAL + OSCCAL_RANGE) > 2 * OSCCAL_RANGE) {
+		fail("OSCCAL off the factory value");
+	}
+	if (sim.ee_safe > 0) {
+		fail("eeprom written in the safe state");
+		sim.ee_safe = 0;
+	}
+	check_events();
+#if TRACE_DEPTH > 0
+	if (freeze_due && trace_ring.cause == 0) {
+		if (eedata.trace.cause != _BV(WDRF)) {
+			fail("trace not frozen");
+		}
+		freeze_due = 0;
+	}
+#endif
+	if (irri.flt_writes != flt_writes && !globals.vcc_safe) {
+		memcpy(&newest, &eedata.events[(p->head + p->write - 1) % MAX_EVENTS], sizeof(event_t));
+		if (p->write == 0 || newest.timestamp != p->timestamp) {
+			fail("event not logged");
+		}
+	}
+	if (globals.mode != MODE_DATA) {
+		data_ticks = 0;
+		data_prompts = sim.prompts;
+	} else if (++data_ticks == 3 && sim.prompts == data_prompts) {
+		fail("no command prompt in data mode");
+	}
+	if (sim.wdt_timeout != 0 && sim.now - sim.wdt_last > sim.wdt_timeout) {
+		fail("watchdog timeout");
+		sim.wdt_last = sim.now;
+	}
+}
+
+/**
+ * key held for hold ticks, released for pause ticks
+ */
+static void key_action(uint8_t key, unsigned hold, unsigned pause)
+{
+	while (hold-- > 0) {
+		run_tick(key);
+	}
+	while (pause-- > 0) {
+		run_tick(KEY_NONE);
+	}
+}
+
+/**
+ * random key actions
+ */
+static void key_sequence()
+{
+	register unsigned actions = 1 + rnd(40);
+	register uint8_t key;
+
+	while (actions-- > 0) {
+		key = key_codes[rnd(3)];
+		switch (rnd(8)) {
+			case 0:		// long hold -> KEY_xxx_L or auto-repeat
+				key_action(key, KEY_REPEAT_MAX + rnd(30), rnd(3));
+				break;
+			case 1:		// key change without release
+				key_action(key, 1 + rnd(KEY_REPEAT_MAX + 2), 0);
+				break;
+			case 2:		// pause
+				key_action(KEY_NONE, 0, rnd(4) == 0 ? rnd(300) : rnd(20));
+				break;
+			default:	// hit
+				key_action(key, 1 + rnd(2), 1 + rnd(5));
+				break;
+		}
+	}
+}
+
+/**
+ * MODE_WATCH -> menu item -> mode
+ */
+static void select_mode()
+{
+	register unsigned item = rnd(5);
+
+	key_action(KEY_SET, KEY_REPEAT_MAX + 1, 2);
+	while (item-- > 0) {
+		key_action(KEY_UP, 1, 1);
+	}
+	key_action(KEY_SET, 1, 2);
+}
+
+/**
+ * leave to watch mode, 0 = stuck
+ */
+static int escape()
+{
+	register uint64_t start = tick;
+
+	key_action(KEY_NONE, 0, 2);
+	while (tick - start < ESCAPE_TICKS) {
+		if (globals.mode == MODE_WATCH && globals.submode == 1) {
+			return 1;
+		}
+		if (globals.mode == MODE_RESET) {
+			key_action(KEY_SET, 1, 1);
+		} else if (globals.mode == MODE_WATCH) {
+			key_action(KEY_NONE, 0, 1);
+		} else {
+			key_action(KEY_SET, KEY_REPEAT_MAX + 2, 2);
+		}
+	}
+	return 0;
+}
+
+/**
+ * frost night in watch mode: temperature around the thresholds, changing
+ * every 30[s] for 2...8 hours
+ */
+static void frost_night()
+{
+	register unsigned steps = 240 + rnd(720);
+	register int8_t low = globals.params.temperatures.low;
+	register int8_t high = globals.params.temperatures.high;
+
+	while (steps-- > 0 && globals.mode == MODE_WATCH) {
+		sim.temp = low - 2 + (int16_t)rnd(high - low + 4);
+		key_action(KEY_NONE, 0, THIRTY_SECONDS);
+	}
+}
+
+/**
+ * warm restart after a watchdog reset, RAM outside globals keeps its content
+ * (.noinit), deferred eeprom writes not done yet are lost
+ */
+static void warm_restart(const globals_t *init)
+{
+	register uint32_t timestamp = globals.params.timestamp;
+
+	if (memcmp(&eedata.params, &globals.params, sizeof(params_t)) != 0) {
+		shadow_n = -1;	// deferred params write lost by the reset
+	}
+	memcpy(&globals, init, sizeof(globals_t));
+	ee_pending = 0;
+#if TRACE_DEPTH > 0
+	if (trace_ring.cause == 0) {
+		eedata.trace.cause = EEUNSET;	// the check sees the new frozen trace
+		freeze_due = 1;
+	}
+#endif
+	PORTB = 0;
+	sim_boot(_BV(WDRF));
+	if (globals.params.timestamp + 1 < timestamp) {
+		fail("clock set back by the warm restart");
+	}
+}
+
+static void usage()
+{
+	fprintf(stderr, "usage: stress [-n sequences] [-s seed] [-t ms] [-x] [-v]\n");
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	static globals_t init;
+	unsigned sequences = 10000;
+	uint32_t wdt_max, first_seed;
+	uint8_t mode;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:s:t:xv")) != -1) {
+		switch (opt) {
+			case 'n':
+				sequences = (unsigned)atoi(optarg);
+				break;
+			case 's':
+				seed = (uint32_t)strtoul(optarg, NULL, 0);
+				if (seed == 0) {
+					usage();
+				}
+				break;
+			case 't':
+				gate = (unsigned)atoi(optarg);
+				break;
+			case 'x':
+				sim.parasite = 0;
+				break;
+			case 'v':
+				verbose = 1;
+				break;
+			default:
+				usage();
+		}
+	}
+	if (optind != argc) {
+		usage();
+	}
+
+	first_seed = seed;
+	memcpy(&init, &globals, sizeof(globals_t));
+	sim_boot(_BV(PORF));
+	wdt_max = 0;
+	for (sequence = 0; sequence < sequences; sequence++) {
+		if (globals.mode == MODE_WATCH && rnd(3) == 0) {
+			select_mode();
+		}
+		key_sequence();
+		if (!escape()) {
+			fail("stuck, watch mode not reached");
+			continue;
+		}
+		if (rnd(20) == 0) {
+			key_action(KEY_NONE, 0, rnd(WATCH_RUN));
+		}
+		if (rnd(200) == 0) {
+			frost_night();
+		}
+		if (rnd(100) == 0) {
+			if (sim.wdt_max > wdt_max) {
+				wdt_max = sim.wdt_max;
+			}
+			warm_restart(&init);
+			sim.wdt_max = 0;
+		}
+	}
+	if (sim.wdt_max > wdt_max) {
+		wdt_max = sim.wdt_max;
+	}
+
+	printf("sequences %u, ticks %llu, seed %lu\n", sequences, (unsigned long long)tick, (unsigned long)first_seed);
+	printf("mode     ticks        worst tick [ms]  submode  ticks > 100[ms]\n");
+	for (mode = 0; mode <= MODE_DATA; mode++) {
+		printf("%-8s %-12llu %8.1f         %-8u %llu\n", mode_names[mode], (unsigned long long)stats[mode].ticks,
+			stats[mode].work / 1000.0, stats[mode].submode, (unsigned long long)stats[mode].over);
+	}
+	printf("eeprom bytes written %llu, uart characters %llu, max watchdog reset interval %.1f[ms]\n",
+		(unsigned long long)sim.ee_bytes, (unsigned long long)sim.tx_bytes, wdt_max / 1000.0);
+	printf("events %d, exported %d, ring head %u, lost %u, violations %lu\n", globals.params.write, globals.params.exported,
+		globals.params.head, globals.params.lost, failures);
+	return failures > 0;
+}
@@ -0,0 +1,76 @@
+/*
+ * trace.c
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ */
+#include <stdint.h>
+#include <avr/io.h>
+#include "frostguard.h"
+#include "globals.h"
+#include "trace.h"
+
+#if TRACE_DEPTH > 0
+
+trace_ring_t trace_ring __attribute__((section(".noinit")));
+
+/**
+ * start new trace
+ */
+static void trace_start()
+{
+	register uint8_t i;
+
+	for (i = 0; i < TRACE_DEPTH; i++) {
+		trace_ring.ring[i].mode = 0xFF;
+	}
+	trace_ring.idx = 0;
+	trace_ring.mode = trace_ring.submode = 0xFF;
+	trace_ring.temp = 0;
+	trace_ring.irri_mode = 0;
+	trace_ring.cause = 0;
+	trace_ring.magic = TRACE_MAGIC;
+}
+
+/**
+ * hold the trace ring on watchdog or brown-out reset for trace_freeze(),
+ * a ring still held from an earlier reset (supply voltage safe state since)
+ * is kept with its cause; start new trace otherwise
+ */
+void trace_init(uint8_t mcusr)
+{
+	if (trace_ring.magic == TRACE_MAGIC) {
+		if (trace_ring.cause != 0) {
+			return;
+		}
+		if (mcusr & (_BV(WDRF) | _BV(BORF))) {
+			trace_ring.cause = mcusr;
+			trace_ring.step = 0;
+			return;
+		}
+	}
+	trace_start();
+}
+
+/**
+ * freeze held trace ring into eeprom (oldest entry first), one step per
+ * tick: the cause is unset first and written last, so a partly written
+ * trace is not exported; start new trace after the last step
+ */
+void trace_freeze()
+{
+	register uint8_t step = trace_ring.step++;
+	uint8_t unset = EEUNSET;
+
+	if (step == 0) {
+		ee_update(&unset, &eedata.trace.cause, sizeof(uint8_t));
+	} else if (step <= TRACE_DEPTH) {
+		ee_update(&trace_ring.ring[(trace_ring.idx + step - 1) & (TRACE_DEPTH - 1)], &eedata.trace.ring[step - 1], sizeof(trace_t));
+	} else {
+		ee_update(&trace_ring.cause, &eedata.trace.cause, sizeof(uint8_t));
+		trace_start();
+	}
+}
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * trace.h
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ */ 
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+#include "frostguard.h"
+#include "globals.h"
+
+/**
+ * state transition trace
+ *
+ * ring of the last TRACE_DEPTH state transitions of the mode dispatcher
+ * and of the watch mode irrigation, kept in .noinit RAM over a reset; on
+ * watchdog or brown-out reset trace_init() holds it, trace_freeze() writes
+ * it into eeprom from the tick ISR (one step per tick, not in the supply
+ * voltage safe state) and starts the new trace
+ */
+#if TRACE_DEPTH > 0
+
+#define TRACE_MAGIC	0x7AC3
+#define TRACE_TABLE	0x80	// submode of table modes: TRACE_TABLE | state of mode_table.c
+
+typedef struct
+{
+	uint16_t	magic;		// TRACE_MAGIC = ring valid
+	uint8_t		idx;		// next entry
+	uint8_t		mode;		// last traced globals.mode / submode (trace_submode())
+	uint8_t		submode;
+	int8_t		temp;		// last watch mode temperature / irrigation mode
+	uint8_t		irri_mode;
+	uint8_t		cause;		// MCUSR of the reset to freeze, 0 = none (tracing)
+	uint8_t		step;		// freeze step of trace_freeze()
+	trace_t		ring[TRACE_DEPTH];
+
+} trace_ring_t;
+
+extern trace_ring_t trace_ring;
+
+/**
+ * submode, the table modes keep submode 1 and move through their states
+ */
+static inline uint8_t trace_submode()
+{
+	if ((_BV(globals.mode) & TABLE_MODES) && globals.submode == 1) {
+		return TRACE_TABLE | table_state();
+	}
+	return globals.submode;
+}
+
+static inline void trace_add(uint8_t key, uint8_t submode)
+{
+	register trace_t *tp = &trace_ring.ring[trace_ring.idx];
+
+	if (trace_ring.cause != 0) {
+		return;		// ring held until frozen
+	}
+	trace_ring.idx = (trace_ring.idx + 1) & (TRACE_DEPTH - 1);
+	tp->tick = (uint16_t)globals.params.timestamp;
+	tp->mode = globals.mode;
+	tp->submode = submode;
+	tp->key = key;
+	tp->temp = trace_ring.temp;
+	tp->irri_mode = trace_ring.irri_mode;
+}
+
+/**
+ * trace mode / submode / table state change after dispatcher call
+ */
+static inline void trace_dispatch(uint8_t key)
+{
+	register uint8_t submode = trace_submode();
+
+	if (globals.mode != trace_ring.mode || submode != trace_ring.submode) {
+		trace_ring.mode = globals.mode;
+		trace_ring.submode = submode;
+		trace_add(key, submode);
+	}
+}
+
+/**
+ * trace irrigation mode change of watch mode
+ */
+static inline void trace_watch(int8_t temp, uint8_t irri_mode)
+{
+	trace_ring.temp = temp;
+	trace_ring.irri_mode = irri_mode;
+	trace_add(KEY_NONE, globals.submode);
+}
+
+void trace_init(uint8_t mcusr);
+void trace_freeze(void);
+
+#define TRACE_DISPATCH(key)			trace_dispatch(key)
+#define TRACE_WATCH(temp, irri_mode)	trace_watch(temp, irri_mode)
+#define TRACE_INIT(mcusr)			trace_init(mcusr)
+#define TRACE_FREEZE()				if (trace_ring.cause != 0 && !globals.vcc_safe) trace_freeze()
+
+#else
+
+#define TRACE_DISPATCH(key)
+#define TRACE_WATCH(temp, irri_mode)
+#define TRACE_INIT(mcusr)
+#define TRACE_FREEZE()
+
+#endif
+
+#endif /* TRACE_H_ */
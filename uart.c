@@ -5,13 +5,14 @@
  *
  * (c) TDSystem Thomas Dausner 2021
  *
- * simple serial transfer library
+ * simple serial transfer library (bit banging, half duplex)
  */ 
 
 // #define F_CPU 1E6	// 1,0 MHz - set in tool chain
 #include <stddef.h>
 #include <avr/io.h>
 #include <avr/common.h>
+#include <avr/pgmspace.h>
 #include <util/delay.h>
 #include "uart.h"
 
@@ -56,3 +57,152 @@ void uart_tx_string(char *s)
 		uart_tx(*s++);
 	} while (*s != 0);
 }
+
+/**
+ * transmit zero terminated string from flash (PSTR())
+ */
+void uart_tx_string_P(const char *s)
+{
+	register char c;
+
+	while ((c = pgm_read_byte(s++)) != 0) {
+		uart_tx(c);
+	}
+}
+
+/**
+ * receive byte
+ *
+ * waits up to timeout poll loops for the start bit, returns UART_RX_NONE
+ * on timeout or if the start bit is a glitch
+ *
+ * the start bit is sampled after 1/2 bit time, data bits are sampled
+ * every 52,1[us] - delays are adjusted like in uart_tx()
+ */
+int16_t uart_rx(uint16_t timeout)
+{
+	register uint8_t bit = _BV(0);
+	register uint8_t data = 0;
+
+	UART_RXDRR &= ~_BV(UART_RXBIT);	// in
+	UART_RXPORT |= _BV(UART_RXBIT);	// pull up
+	while (UART_RXPIN & _BV(UART_RXBIT)) {
+		if (--timeout == 0) {
+			return UART_RX_NONE;
+		}
+		_delay_us(3);
+	}
+	_delay_us(18);	// middle of start bit
+	if (UART_RXPIN & _BV(UART_RXBIT)) {
+		return UART_RX_NONE;
+	}
+	while (bit) {
+		_delay_us(43);
+		if (UART_RXPIN & _BV(UART_RXBIT)) {
+			data |= bit;
+		}
+		bit <<= 1;
+	}
+	_delay_us(52);	// stop bit
+	return data;
+}
+
+/**
+ * receive line terminated by '\n' into zero terminated buf ('\r' is ignored)
+ *
+ * waits up to timeout poll loops for the first character, returns length
+ * of line or 0 if no (complete) line was received
+ */
+uint8_t uart_rx_line(char *buf, uint8_t size, uint16_t timeout)
+{
+	register uint8_t len = 0;
+	register int16_t c;
+
+	while ((c = uart_rx(len == 0 ? timeout : UART_RX_MS(20))) != '\n') {
+		if (c == UART_RX_NONE) {
+			len = 0;
+			break;
+		}
+		if (c != '\r' && len < size - 1) {
+			buf[len++] = (char)c;
+		}
+	}
+	buf[len] = 0;
+	return len;
+}
+
+/**
+ * measure 4 x 8 bit times of the sync pattern in Timer1 ticks (CK/2)
+ *
+ * the host sends 'U' (0x55) back to back, resulting in a square wave with
+ * a period of 2 bit times on the line, 4 periods are measured per call
+ *
+ * returns UART_RX_NONE on timeout
+ */
+static int16_t uart_sync_ticks()
+{
+	register uint16_t timeout = UART_RX_MS(50);
+	register uint8_t edges;
+	register uint16_t ticks = 0;
+	register uint8_t n;
+
+	TCCR1 = _BV(CS11);	// CK/2
+	for (n = 0; n < 4; n++) {
+		for (edges = 0; edges < 5; edges++) {
+			while (!(UART_RXPIN & _BV(UART_RXBIT))) {	// wait for high level
+				if (--timeout == 0) {
+					return UART_RX_NONE;
+				}
+			}
+			while (UART_RXPIN & _BV(UART_RXBIT)) {		// wait for falling edge
+				if (--timeout == 0) {
+					return UART_RX_NONE;
+				}
+			}
+			if (edges == 0) {
+				TCNT1 = 0;
+				TIFR = _BV(TOV1);
+			}
+		}
+		ticks += TIFR & _BV(TOV1) ? 0xFF : TCNT1;
+	}
+	TCCR1 = 0;
+	return ticks;
+}
+
+/**
+ * calibrate the RC oscillator (OSCCAL) from the host sync pattern
+ *
+ * binary search over OSCCAL bits 6...0, bit 7 (oscillator range) is kept
+ * - too many ticks -> clock too fast -> clear bit
+ *
+ * waits for the end of the sync pattern, returns calibrated OSCCAL or
+ * UART_RX_NONE if there was no sync pattern (OSCCAL unchanged)
+ */
+#define UART_SYNC_TICKS	((uint16_t)(F_CPU / 2 * 8 * 4 / 19200))
+
+int16_t uart_calibrate()
+{
+	register uint8_t osccal = OSCCAL;
+	register uint8_t step;
+	register int16_t ticks;
+
+	UART_RXDRR &= ~_BV(UART_RXBIT);	// in
+	UART_RXPORT |= _BV(UART_RXBIT);	// pull up
+	OSCCAL &= 0x80;
+	for (step = 0x40; step != 0; step >>= 1) {
+		OSCCAL |= step;
+		_delay_us(100);	// oscillator settling
+		if ((ticks = uart_sync_ticks()) == UART_RX_NONE) {
+			OSCCAL = osccal;
+			return UART_RX_NONE;
+		}
+		if (ticks > UART_SYNC_TICKS) {
+			OSCCAL &= ~step;
+		}
+	}
+	while (uart_rx(UART_RX_MS(5)) != UART_RX_NONE) {
+		;	// skip rest of sync pattern
+	}
+	return OSCCAL;
+}
@@ -12,11 +12,23 @@
 #define UART_TXDRR	DDRB
 #define UART_TXPORT	PORTB
 #define UART_TXBIT	PB3
+#define UART_RXDRR	DDRB
+#define UART_RXPORT	PORTB
+#define UART_RXPIN	PINB
+#define UART_RXBIT	PB3
 /**
- * no RX implemented
+ * RX shares the pin with TX (half duplex)
+ *
+ * rx timeout is counted in poll loops of ~10[us]
  */
+#define UART_RX_NONE	-1
+#define UART_RX_MS(ms)	((uint16_t)(ms) * 100)
 
 void uart_tx(char data);
 void uart_tx_string(char *s);
+void uart_tx_string_P(const char *s);
+int16_t uart_rx(uint16_t timeout);
+uint8_t uart_rx_line(char *buf, uint8_t size, uint16_t timeout);
+int16_t uart_calibrate();
 
 #endif /* UART_H_ */
\ No newline at end of file
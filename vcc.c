@@ -0,0 +1,28 @@
+/*
+ * vcc.c
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ */
+#include <stdint.h>
+#include <avr/io.h>
+#include "vcc.h"
+
+/**
+ * read supply voltage (ADC started by VCC_START()), ADC off afterwards
+ *
+ * returns Vcc in VCC_UNIT [mV], 0xFF = 5.1[V] or above
+ */
+uint8_t vcc_read()
+{
+	register uint16_t adc;
+	register uint16_t vcc;
+
+	ADCSRA |= _BV(ADSC);
+	loop_until_bit_is_clear(ADCSRA, ADSC);
+	adc = ADC;
+	VCC_STOP();
+	vcc = adc > 0 ? VCC_BANDGAP / adc : 0xFF;
+	return vcc > 0xFF ? 0xFF : (uint8_t)vcc;
+}
@@ -0,0 +1,35 @@
+/*
+ * vcc.h
+ *
+ * Created: 18.10.2026
+ *
+ * (c) TDSystem Thomas Dausner 2021
+ */ 
+
+#ifndef VCC_H_
+#define VCC_H_
+
+#include <stdint.h>
+#include <avr/io.h>
+
+/**
+ * supply voltage measurement
+ *
+ * the internal 1.1[V] bandgap is measured with Vcc as ADC reference:
+ * Vcc = 1.1[V] * 1024 / ADC. The ADC is switched on one tick before the
+ * reading (bandgap settling time) and off after the reading.
+ *
+ * voltages are kept in VCC_UNIT [mV] steps in one byte (0...5.1[V])
+ */
+#define VCC_UNIT		20
+#define VCC(v)			((uint8_t)((v) * 1000 / VCC_UNIT))	// [V] -> VCC_UNIT
+#define VCC_BANDGAP		(1100UL * 1024 / VCC_UNIT)
+#define VCC_HYST		VCC(0.1)	// safe state left above threshold + VCC_HYST
+#define DEFAULT_VCC_LOW	VCC(2.9)	// safe state threshold (0 = off)
+
+#define VCC_START()		(ADMUX = _BV(MUX3) | _BV(MUX2), ADCSRA = _BV(ADEN) | _BV(ADPS1) | _BV(ADPS0))	// Vcc ref, bandgap, 125[kHz]
+#define VCC_STOP()		(ADCSRA = 0)
+
+uint8_t vcc_read();
+
+#endif /* VCC_H_ */